@@ -2,63 +2,392 @@
 // for details. All rights reserved. Use of this source code is governed by a
 // BSD-style license that can be found in the LICENSE.md file.
 
+#include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "src/assert.h"
 
 #include "src/builder.h"
 #include "src/parser.h"
+#include "src/parser_statistics.h"
 #include "src/pretty_printer.h"
 #include "src/scanner.h"
+#include "src/string_buffer.h"
+#include "src/token_cache.h"
 #include "src/tokens.h"
 
 namespace rart {
 
-// TODO(kasperl): Move this to tokens.h?
-static const Token kKeywordTokens[] = {
-#define T(n, s, p) n,
-KEYWORD_LIST(T)
-#undef T
+// The state shared by the builders that parse the declarations of a unit
+// in parallel. Terminals that were registered before the parse are read
+// from flat copies of the registries without locking. Everything else
+// goes to the builder that builds the unit, under the lock.
+struct Builder::Shared {
+  Builder* builder;
+  const TokenColumns* tokens;
+  pthread_mutex_t mutex;
+  List<StringSlice> identifiers;
+  List<TreeNode*> registry;
+  List<LiteralStringNode*> strings;
+};
+
+struct Builder::ParseTask {
+  Shared* shared;
+  int begin;
+  int end;
+  pthread_t thread;
+  List<TreeNode*> declarations;
+  List<Diagnostic> diagnostics;
+};
+
+// The top-level declarations parsed from a range of tokens, with the
+// nodes in them that have locations. Ranges with errors are not reused,
+// so their errors are reported again.
+struct Builder::DeclarationRange {
+  u64 hash;
+  Location start;
+  u32 length;
+  bool has_errors;
+  List<TreeNode*> declarations;
+  List<TreeNode*> located;
+};
+
+class SharedLock : public StackAllocated {
+ public:
+  explicit SharedLock(pthread_mutex_t* mutex) : mutex_(mutex) {
+    pthread_mutex_lock(mutex_);
+  }
+
+  ~SharedLock() {
+    pthread_mutex_unlock(mutex_);
+  }
+
+ private:
+  pthread_mutex_t* const mutex_;
 };
 
 Builder::Builder(Zone* zone)
-    : zone_(zone)
+    : Builder(zone, NULL) {
+}
+
+Builder::Builder(Zone* zone, Shared* shared)
+    : shared_(shared)
+    , zone_(zone)
     , source_(zone)
-    , identifier_root_(new(zone) TerminalTrieNode(zone))
-    , number_root_(new(zone) TerminalTrieNode(zone))
+    , identifier_interner_(zone)
+    , integer_ids_(zone)
+    , double_ids_(zone)
     , nodes_(zone)
     , registry_(zone)
     , identifiers_(zone)
     , string_registry_(zone)
-    , builtins_(List<int>::New(zone, Tokens::kNumberOfBuiltins)) {
-  unsigned keywords = ARRAY_SIZE(kKeywordTokens);
-  for (unsigned i = 0; i < keywords; i++) {
-    Token token = kKeywordTokens[i];
-    const char* keyword = Tokens::Syntax(token);
-    TerminalTrieNode* node = identifier_root_;
-    int c;
-    while ((c = *keyword++) != '\0') {
-      node = node->Child(zone, c);
-    }
-    node->is_keyword_ = true;
-    node->terminal_ = token;
-    if (Tokens::IsIdentifier(token)) {
-      builtins_[token - kABSTRACT] = RegisterIdentifier(Tokens::Syntax(token));
-    }
+    , diagnostics_(zone)
+    , unit_ranges_(zone)
+    , located_(zone) {
+  if (shared != NULL) {
+    lazy_method_bodies_ = shared->builder->lazy_method_bodies_;
+    outline_ = shared->builder->outline_;
+    return;
+  }
+  // The builtin identifiers are registered first, so their ids are the
+  // same in every builder.
+  for (int i = 0; i < Tokens::kNumberOfBuiltins; i++) {
+    Token token = static_cast<Token>(kABSTRACT + i);
+    StringSlice name(Tokens::Syntax(token), Tokens::SyntaxLength(token));
+    int id = RegisterIdentifier(name);
+    ASSERT(id == BuiltinId(token));
+    USE(id);
   }
 }
 
 CompilationUnitNode* Builder::BuildUnit(Location location) {
+  return BuildUnit(location, List<DeclarationRange>());
+}
+
+CompilationUnitNode* Builder::RebuildUnit(CompilationUnitNode* previous,
+                                          Location location) {
+  ASSERT(incremental_);
+  List<DeclarationRange> ranges;
+  auto it = unit_ranges_.Find(previous);
+  if (it != unit_ranges_.End()) {
+    ranges = it->second;
+    unit_ranges_.Erase(it);
+  }
+  return BuildUnit(location, ranges);
+}
+
+CompilationUnitNode* Builder::BuildUnit(Location location,
+                                        List<DeclarationRange> previous) {
+#ifdef PARSER_STATISTICS
+  statistics()->Clear();
+#endif
+  Location invalid = source_.FindInvalidUtf8(location);
+  if (!invalid.IsInvalid()) ReportError(invalid, "Invalid UTF-8");
   Zone zone;
-  Scanner scanner(&zone, this);
-  scanner.Scan(source_.GetSource(location), location);
-  Parser parser(this, scanner.EncodedTokens());
-  parser.ParseCompilationUnit();
+  Zone* token_zone = lazy_method_bodies() ? zone_ : &zone;
+  const char* source = source_.GetSource(location);
+  TokenColumns tokens = (token_cache_ != NULL)
+      ? token_cache_->Scan(this, token_zone, source, location)
+      : ScanTokens(token_zone, source, location);
+  List<DeclarationRange> ranges;
+  if (incremental_) {
+    ranges = ParseUnitIncrementally(tokens, previous);
+  } else {
+    ParseUnit(tokens);
+  }
   CompilationUnitNode* unit = Pop()->AsCompilationUnit();
   ASSERT(nodes_.is_empty());
+  if (incremental_) unit_ranges_.AtPut(zone_, unit) = ranges;
+#ifdef PARSER_STATISTICS
+  statistics()->Print(source_.GetFilePath(location));
+#endif
   return unit;
 }
 
+void Builder::ParseUnit(TokenColumns tokens) {
+  int threads = Utils::Minimum(
+      parse_threads_, tokens.length() / kMinimumTokensPerParseThread);
+  if (threads <= 1) {
+    Parser parser(this, tokens);
+    parser.ParseCompilationUnit();
+    return;
+  }
+
+  Zone zone;
+  ListBuilder<int, 256> positions(&zone);
+  int end = 0;
+  if (!SplitDeclarations(tokens, &positions, &end)) {
+    Parser parser(this, tokens);
+    parser.ParseCompilationUnit();
+    return;
+  }
+  List<int> starts = positions.ToList();
+
+  // Cut the declarations into ranges with about the same number of tokens.
+  Shared shared;
+  shared.builder = this;
+  shared.tokens = &tokens;
+  ParseTask* tasks = static_cast<ParseTask*>(
+      zone.Allocate(threads * sizeof(ParseTask)));
+  int count = 0;
+  for (int i = 0; i < starts.length() && count < threads; i++) {
+    int begin = starts[i];
+    int size = end - starts[0];
+    int split = starts[0] + static_cast<int>(
+        static_cast<i64>(size) * count / threads);
+    if (begin < split) continue;
+    if (count > 0) tasks[count - 1].end = begin;
+    ParseTask* task = &tasks[count++];
+    task->shared = &shared;
+    task->begin = begin;
+  }
+  if (count > 0) tasks[count - 1].end = end;
+
+  shared.identifiers = identifiers_.ToList();
+  shared.registry = registry_.ToList();
+  shared.strings = string_registry_.ToList();
+  pthread_mutex_init(&shared.mutex, NULL);
+  // The first range is parsed on this thread.
+  for (int i = 1; i < count; i++) {
+    pthread_create(&tasks[i].thread, NULL, &RunParseTask, &tasks[i]);
+  }
+  if (count > 0) RunParseTask(&tasks[0]);
+  for (int i = 1; i < count; i++) pthread_join(tasks[i].thread, NULL);
+  pthread_mutex_destroy(&shared.mutex);
+
+  // All threads are done with this builder's zone, so the declarations
+  // can be pushed now. The errors are collected in the order of the
+  // ranges, so they are in the same order as when parsing on one thread.
+  int declarations = 0;
+  for (int i = 0; i < count; i++) {
+    List<TreeNode*> nodes = tasks[i].declarations;
+    for (int j = 0; j < nodes.length(); j++) Push(nodes[j]);
+    declarations += nodes.length();
+    List<Diagnostic> diagnostics = tasks[i].diagnostics;
+    for (int j = 0; j < diagnostics.length(); j++) {
+      diagnostics_.Add(diagnostics[j]);
+    }
+  }
+  DoCompilationUnit(declarations);
+}
+
+// Finds where the top-level declarations of the unit start, and where the
+// last one ends. Returns false if they can't be found because the unit has
+// errors; parsing it reports them.
+bool Builder::SplitDeclarations(TokenColumns tokens,
+                                ListBuilder<int, 256>* starts,
+                                int* end) {
+  int errors = diagnostics_.length();
+  Parser splitter(this, tokens);
+  if (!splitter.ParseWithRecovery(&Parser::SkipLibrary)) {
+    while (diagnostics_.length() > errors) diagnostics_.RemoveLast();
+    return false;
+  }
+  while (!splitter.is_at_end()) {
+    starts->Add(splitter.position());
+    if (!splitter.SkipToplevelDeclaration()) return false;
+  }
+  *end = splitter.position();
+  return true;
+}
+
+// Parses the unit one range of declarations at a time. A range with the
+// same source as a range of the previous version of the unit has the same
+// declarations, so they are reused and moved to where the range is now.
+// The hashes find the candidates, and the bytes are compared to rule out
+// collisions.
+// The whole unit is still scanned and hashed, but that is cheap next to
+// parsing. Returns the ranges, or an empty list if the unit
+// couldn't be split and was parsed as a whole.
+List<Builder::DeclarationRange> Builder::ParseUnitIncrementally(
+    TokenColumns tokens, List<DeclarationRange> previous) {
+  Zone zone;
+  ListBuilder<int, 256> positions(&zone);
+  int end = 0;
+  if (!SplitDeclarations(tokens, &positions, &end)) {
+    Parser parser(this, tokens);
+    parser.ParseCompilationUnit();
+    located_.Clear();
+    return List<DeclarationRange>();
+  }
+  List<int> starts = positions.ToList();
+
+  // Chain the previous ranges with the same hash, so identical ranges are
+  // each reused once.
+  HashMap<u64, int> first(&zone);
+  List<int> next = List<int>::New(&zone, previous.length());
+  for (int i = previous.length() - 1; i >= 0; i--) {
+    if (previous[i].has_errors) continue;
+    auto it = first.Find(previous[i].hash);
+    next[i] = (it == first.End()) ? -1 : it->second;
+    first.AtPut(&zone, previous[i].hash) = i;
+  }
+
+  List<DeclarationRange> ranges =
+      List<DeclarationRange>::New(zone_, starts.length());
+  int count = 0;
+  for (int i = 0; i < starts.length(); i++) {
+    int begin = starts[i];
+    int range_end = (i + 1 < starts.length()) ? starts[i + 1] : end;
+    DeclarationRange* range = &ranges[i];
+    range->start = tokens.locations()[begin];
+    range->length = tokens.locations()[range_end].raw() - range->start.raw();
+    range->hash = HashSource(range->start, tokens.locations()[range_end]);
+    const char* source = source_.GetSource(range->start);
+    int* link = NULL;
+    auto it = first.Find(range->hash);
+    if (it != first.End()) {
+      link = &it->second;
+      while (*link >= 0) {
+        DeclarationRange* candidate = &previous[*link];
+        if (candidate->length == range->length &&
+            memcmp(source_.GetSource(candidate->start), source,
+                   range->length) == 0) {
+          break;
+        }
+        link = &next[*link];
+      }
+    }
+    if (link != NULL && *link >= 0) {
+      DeclarationRange* reused = &previous[*link];
+      *link = next[*link];
+      u32 delta = range->start.raw() - reused->start.raw();
+      List<TreeNode*> located = reused->located;
+      for (int j = 0; j < located.length(); j++) {
+        IdentifierNode* identifier = located[j]->AsIdentifier();
+        if (identifier != NULL) {
+          identifier->set_location(identifier->location() + delta);
+        } else {
+          ParenthesizedNode* parenthesized = located[j]->AsParenthesized();
+          parenthesized->set_location(parenthesized->location() + delta);
+        }
+      }
+      range->has_errors = false;
+      range->declarations = reused->declarations;
+      range->located = located;
+    } else {
+      int errors = diagnostics_.length();
+      located_.Clear();
+      Parser parser(this, tokens, begin);
+      int declarations = parser.ParseToplevelDeclarations(range_end);
+      range->has_errors = diagnostics_.length() > errors;
+      range->declarations = PopList(declarations);
+      range->located = located_.ToList();
+    }
+    List<TreeNode*> declarations = range->declarations;
+    for (int j = 0; j < declarations.length(); j++) Push(declarations[j]);
+    count += declarations.length();
+  }
+  located_.Clear();
+  DoCompilationUnit(count);
+  return ranges;
+}
+
+// Hashes the source of a range of declarations, from its first token to
+// the first token after it. The scanner starts a declaration in the same
+// state wherever it is, so ranges with the same source have the same
+// tokens at the same offsets from their start.
+u64 Builder::HashSource(Location start, Location end) {
+  return Utils::ContentHash(source_.GetSource(start), end.raw() - start.raw());
+}
+
+void* Builder::RunParseTask(void* argument) {
+  ParseTask* task = static_cast<ParseTask*>(argument);
+  Shared* shared = task->shared;
+  Zone zone;
+  Builder builder(&zone, shared);
+  {
+    Parser parser(&builder, *shared->tokens, task->begin);
+    int count = parser.ParseToplevelDeclarations(task->end);
+    task->declarations = builder.Nodes();
+    task->diagnostics = builder.Diagnostics();
+    ASSERT(task->declarations.length() == count);
+    USE(count);
+  }
+  SharedLock lock(&shared->mutex);
+#ifdef PARSER_STATISTICS
+  shared->builder->statistics()->Add(*builder.statistics());
+#endif
+  shared->builder->zone()->Adopt(&zone);
+  return NULL;
+}
+
+class LazyMethodBody : public LazyBody {
+ public:
+  LazyMethodBody(Builder* builder, TokenColumns tokens, int position)
+      : builder_(builder), tokens_(tokens), position_(position) {
+  }
+
+  virtual TreeNode* Parse() {
+    return builder_->ParseLazyBody(tokens_, position_);
+  }
+
+ private:
+  Builder* const builder_;
+  const TokenColumns tokens_;
+  const int position_;
+};
+
+TreeNode* Builder::ParseLazyBody(TokenColumns tokens, int position) {
+  int height = nodes_.length();
+  Parser parser(this, tokens, position);
+  // The statements recover from their errors. An error in the braces
+  // around them leaves an empty body.
+  if (!parser.ParseWithRecovery(&Parser::ParseBlock)) DoBlock(0);
+  TreeNode* body = Pop();
+  ASSERT(nodes_.length() == height);
+  USE(height);
+  return body;
+}
+
+TokenColumns Builder::ScanTokens(Zone* zone, const char* source,
+                                 Location location) {
+  Scanner scanner(zone, this);
+  scanner.Scan(source, location);
+  return scanner.EncodedTokenColumns();
+}
+
 List<TreeNode*> Builder::Nodes() {
   return nodes_.ToList();
 }
@@ -68,32 +397,74 @@ IdentifierNode* Builder::OperatorName(Token token) {
   return Canonicalize(Tokens::Syntax(token));
 }
 
+TreeNode* Builder::Lookup(int id) {
+  if (shared_ == NULL) return registry_.Get(id);
+  if (id < shared_->registry.length()) return shared_->registry[id];
+  SharedLock lock(&shared_->mutex);
+  return shared_->builder->Lookup(id);
+}
+
+StringSlice Builder::LookupIdentifier(int id) {
+  if (shared_ == NULL) return identifiers_.Get(id);
+  if (id < shared_->identifiers.length()) return shared_->identifiers[id];
+  SharedLock lock(&shared_->mutex);
+  return shared_->builder->LookupIdentifier(id);
+}
+
+LiteralStringNode* Builder::LookupString(int id) {
+  if (shared_ == NULL) return string_registry_.Get(id);
+  if (id < shared_->strings.length()) return shared_->strings[id];
+  SharedLock lock(&shared_->mutex);
+  return shared_->builder->LookupString(id);
+}
+
 IdentifierNode* Builder::BuiltinName(Token token) {
-  int id = builtins_[token - kABSTRACT];
-  const char* value = LookupIdentifier(id);
+  int id = BuiltinId(token);
+  StringSlice value = LookupIdentifier(id);
   return new(zone()) IdentifierNode(
       id,
       value,
       Location());
 }
 
-int Builder::ComputeCanonicalId(const char* name) {
-  TerminalTrieNode* node = identifier_root_;
-  int c;
-  const char* p = name;
-  while ((c = *p++) != '\0') {
-    node = node->Child(zone(), c);
+int Builder::ComputeCanonicalId(StringSlice name) {
+  if (shared_ != NULL) {
+    SharedLock lock(&shared_->mutex);
+    return shared_->builder->ComputeCanonicalId(name);
   }
-  if (node->is_keyword_) return -1;
-  int terminal = node->terminal_;
+  const char* data = name.data();
+  int length = name.length();
+  if (Tokens::LookupKeyword(data, length) != kIDENTIFIER) return -1;
+  Interner::Entry* entry = identifier_interner_.Lookup(data, length, false);
+  int terminal = entry->terminal;
   if (terminal < 0) {
-    terminal = node->terminal_ = RegisterIdentifier(name);
+    terminal = entry->terminal = RegisterIdentifier(name);
   }
   return terminal;
 }
 
+int Builder::ComputeCanonicalIntegerId(i64 value) {
+  auto it = integer_ids_.Find(value);
+  if (it != integer_ids_.End()) return it->second;
+  int id = RegisterInteger(value);
+  integer_ids_.AtPut(zone(), value) = id;
+  return id;
+}
+
+int Builder::ComputeCanonicalDoubleId(double value) {
+  // The hash map uses the low bits of the key as the hash code. Those
+  // are mostly zero for the doubles found in programs, so key by the
+  // byte-swapped bits instead.
+  u64 key = __builtin_bswap64(bit_cast<u64>(value));
+  auto it = double_ids_.Find(key);
+  if (it != double_ids_.End()) return it->second;
+  int id = RegisterDouble(value);
+  double_ids_.AtPut(zone(), key) = id;
+  return id;
+}
+
 IdentifierNode* Builder::Canonicalize(const char* name) {
-  int terminal = ComputeCanonicalId(name);
+  int terminal = ComputeCanonicalId(StringSlice(name));
   if (terminal < 0) return NULL;
   return new(zone()) IdentifierNode(
       terminal,
@@ -158,25 +529,42 @@ void Builder::DoTypedef(int parameter_count) {
 void Builder::DoMethod(Modifiers modifiers,
                        int parameter_count,
                        int initializer_count) {
-  TreeNode* body = Pop();
+  LazyBody* lazy_body;
+  TreeNode* body = PopMethodBody(&lazy_body);
   List<TreeNode*> initializers = PopList(initializer_count);
   List<VariableDeclarationNode*> parameters =
       PopVariableDeclarationList(parameter_count);
   TreeNode* name = Pop();
-  Push(new(zone()) MethodNode(modifiers, name, parameters, initializers, body));
+  Push(new(zone()) MethodNode(
+      modifiers, name, parameters, initializers, body, lazy_body));
 }
 
 void Builder::DoOperator(Token token,
                          Modifiers modifiers,
                          int parameter_count) {
-  TreeNode* body = Pop();
+  LazyBody* lazy_body;
+  TreeNode* body = PopMethodBody(&lazy_body);
   List<TreeNode*> initializers = PopList(0);  // ???
   List<VariableDeclarationNode*> parameters =
       PopVariableDeclarationList(parameter_count);
   IdentifierNode* name = (token == kSUB && parameter_count == 0) ?
       Canonicalize("unary-") :
       OperatorName(token);
-  Push(new(zone()) MethodNode(modifiers, name, parameters, initializers, body));
+  Push(new(zone()) MethodNode(
+      modifiers, name, parameters, initializers, body, lazy_body));
+}
+
+void Builder::DoLazyBody(TokenColumns tokens, int position) {
+  ASSERT(lazy_body_ == NULL);
+  Builder* builder = (shared_ != NULL) ? shared_->builder : this;
+  lazy_body_ = new(zone()) LazyMethodBody(builder, tokens, position);
+}
+
+TreeNode* Builder::PopMethodBody(LazyBody** lazy_body) {
+  *lazy_body = lazy_body_;
+  if (lazy_body_ == NULL) return Pop();
+  lazy_body_ = NULL;
+  return NULL;
 }
 
 void Builder::DoBlock(int count) {
@@ -385,6 +773,22 @@ void Builder::DoFunctionExpression(int parameter_count) {
   Push(new(zone()) FunctionExpressionNode(parameters, body));
 }
 
+void Builder::DoSymbolPart(Token token, int id) {
+  StringSlice value = (token == kIDENTIFIER)
+      ? LookupIdentifier(id)
+      : StringSlice(Tokens::Syntax(token));
+  DoStringReference(RegisterString(value));
+}
+
+void Builder::DoSymbol(int part_count) {
+  DoString(part_count);
+  TreeNode* name = Pop();
+  PushIdentifier(Canonicalize("Symbol"));
+  Push(name);
+  DoInvoke(1, 0);
+  DoNew(true);
+}
+
 void Builder::DoEmptyStatement() {
   Push(new(zone()) EmptyStatementNode());
 }
@@ -396,22 +800,27 @@ void Builder::DoExpressionStatement() {
 
 void Builder::DoParenthesizedExpression(Location location) {
   ExpressionNode* expression = Pop()->AsExpression();
-  Push(new(zone()) ParenthesizedNode(location, expression));
+  ParenthesizedNode* node = new(zone()) ParenthesizedNode(location, expression);
+  if (incremental_) located_.Add(node);
+  Push(node);
 }
 
 void Builder::DoString(int count) {
   // If one, it's already on the stack.
   if (count == 1) return;
-  ListBuilder<char, 256> chars(zone());
   List<TreeNode*> parts = PopList(count);
+  int length = 0;
   for (int i = 0; i < count; i++) {
-    LiteralStringNode* node = parts[i]->AsLiteralString();
-    const char* value = node->value();
-    int length = strlen(value);
-    for (int j = 0; j < length; j++) chars.Add(value[j]);
+    length += parts[i]->AsLiteralString()->value().length();
   }
-  chars.Add('\0');
-  Push(new(zone()) LiteralStringNode(chars.ToList().data()));
+  char* chars = static_cast<char*>(zone()->Allocate(length));
+  int offset = 0;
+  for (int i = 0; i < count; i++) {
+    StringSlice value = parts[i]->AsLiteralString()->value();
+    memcpy(chars + offset, value.data(), value.length());
+    offset += value.length();
+  }
+  Push(new(zone()) LiteralStringNode(StringSlice(chars, length)));
 }
 
 void Builder::DoStringInterpolation(int count) {
@@ -463,8 +872,10 @@ void Builder::DoReference(int id) {
 }
 
 void Builder::DoIdentifier(int id, Location location) {
-  const char* value = LookupIdentifier(id);
-  Push(new(zone()) IdentifierNode(id, value, location));
+  StringSlice value = LookupIdentifier(id);
+  IdentifierNode* node = new(zone()) IdentifierNode(id, value, location);
+  if (incremental_ && !location.IsInvalid()) located_.Add(node);
+  Push(node);
 }
 
 void Builder::DoStringReference(int id) {
@@ -473,7 +884,7 @@ void Builder::DoStringReference(int id) {
 
 void Builder::DoBuiltin(Token token) {
   ASSERT(Tokens::IsIdentifier(token) && token != kIDENTIFIER);
-  DoIdentifier(builtins_[token - kABSTRACT], Location());
+  DoIdentifier(BuiltinId(token), Location());
 }
 
 int Builder::RegisterInteger(i64 value) {
@@ -489,18 +900,33 @@ int Builder::RegisterDouble(double value) {
   return id;
 }
 
-int Builder::RegisterIdentifier(const char* value) {
+int Builder::RegisterIdentifier(StringSlice value) {
   int id = identifiers_.length();
   identifiers_.Add(value);
   return id;
 }
 
-int Builder::RegisterString(const char* value) {
+int Builder::RegisterString(StringSlice value) {
+  if (shared_ != NULL) {
+    SharedLock lock(&shared_->mutex);
+    return shared_->builder->RegisterString(value);
+  }
   int id = string_registry_.length();
   string_registry_.Add(new(zone()) LiteralStringNode(value));
   return id;
 }
 
+void Builder::TruncateStrings(int count) {
+  while (string_registry_.length() > count) string_registry_.RemoveLast();
+}
+
+int Builder::AdoptStrings(List<LiteralStringNode*> strings) {
+  ASSERT(shared_ == NULL);
+  int id = string_registry_.length();
+  for (int i = 0; i < strings.length(); i++) string_registry_.Add(strings[i]);
+  return id;
+}
+
 void Builder::ReportError(Location location, const char* format, ...) {
   va_list args;
   va_start(args, format);
@@ -509,20 +935,48 @@ void Builder::ReportError(Location location, const char* format, ...) {
 }
 
 void Builder::ReportError(Location location, const char* format, va_list args) {
-  const char* file_path = source()->GetFilePath(location);
-  fprintf(stderr, "%s: ", file_path);
-  vfprintf(stderr, format, args);
-  fprintf(stderr, "\n");
-  if (!location.IsInvalid()) {
-    int line_length = 0;
-    const char* line = source()->GetLine(location, &line_length);
-    fprintf(stderr, "%.*s\n", line_length, line);
-    const char* src = source()->GetSource(location);
-    int offset = src - line;
-    fprintf(stderr, "%*s\n", offset + 1, "^");
+  StringBuffer buffer(zone());
+  buffer.VPrint(format, args);
+  Diagnostic diagnostic = { location, buffer.ToString() };
+  diagnostics_.Add(diagnostic);
+}
+
+void Builder::PrintDiagnostics() {
+  List<Diagnostic> diagnostics = Diagnostics();
+  for (int i = 0; i < diagnostics.length(); i++) {
+    Diagnostic diagnostic = diagnostics[i];
+    Location location = diagnostic.location;
+    const char* file_path = source()->GetFilePath(location);
+    if (location.IsInvalid()) {
+      fprintf(stderr, "%s: ", file_path);
+    } else {
+      int line_number = 0;
+      int column = 0;
+      source()->GetLineAndColumn(location, &line_number, &column);
+      fprintf(stderr, "%s:%d:%d: ", file_path, line_number, column);
+    }
+    fprintf(stderr, "%s\n", diagnostic.message);
+    if (!location.IsInvalid()) {
+      int line_length = 0;
+      const char* line = source()->GetLine(location, &line_length);
+      fprintf(stderr, "%.*s\n", line_length, line);
+      const char* src = source()->GetSource(location);
+      int offset = src - line;
+      fprintf(stderr, "%*s\n", offset + 1, "^");
+    }
   }
+}
+
+#ifdef PARSER_STATISTICS
+ParserStatistics* Builder::statistics() {
+  if (statistics_ == NULL) statistics_ = new(zone_) ParserStatistics();
+  return statistics_;
+}
+#endif
 
-  exit(1);
+void Builder::TruncateNodes(int count) {
+  while (nodes_.length() > count) nodes_.RemoveLast();
+  lazy_body_ = NULL;
 }
 
 List<TreeNode*> Builder::PopList(int n) {
@@ -5,20 +5,95 @@
 #ifndef SRC_BUILDER_H_
 #define SRC_BUILDER_H_
 
+#include "src/hash_map.h"
+#include "src/interner.h"
 #include "src/list_builder.h"
 #include "src/tokens.h"
 #include "src/tree.h"
-#include "src/trie.h"
 #include "src/zone.h"
 
 namespace rart {
 
-class TerminalTrieNode : public TrieNode<TerminalTrieNode> {
- public:
-  explicit TerminalTrieNode(Zone* zone) : TrieNode(zone) {}
+class TokenCache;
+class TokenColumns;
+struct ParserStatistics;
+
+// The events the parser sends to a builder, with their parameter types.
+// Each event V(Name, parameters) is a method DoName of the builder.
+#define BUILDER_EVENT_LIST(V)                                                \
+  V(CompilationUnit, (int))                                                  \
+  V(Class, (bool, bool, int, int, int))                                      \
+  V(Combinator, (Token, int))                                                \
+  V(Import, (bool, int))                                                     \
+  V(Export, (int))                                                           \
+  V(Part, ())                                                                \
+  V(PartOf, ())                                                              \
+  V(Typedef, (int))                                                          \
+  V(Method, (Modifiers, int, int))                                           \
+  V(Operator, (Token, Modifiers, int))                                       \
+  V(LazyBody, (TokenColumns, int))                                           \
+  V(Block, (int))                                                            \
+  V(VariableDeclarationStatement, (Modifiers, int))                          \
+  V(VariableDeclaration, (Modifiers, bool))                                  \
+  V(If, (bool))                                                              \
+  V(For, (bool, int))                                                        \
+  V(ForIn, (Token))                                                          \
+  V(While, ())                                                               \
+  V(DoWhile, ())                                                             \
+  V(Break, (bool))                                                           \
+  V(Continue, (bool))                                                        \
+  V(Return, (bool))                                                          \
+  V(Assert, ())                                                              \
+  V(Case, (int))                                                             \
+  V(Switch, (int, int))                                                      \
+  V(Catch, (bool, int))                                                      \
+  V(Try, (int, bool))                                                        \
+  V(LabelledStatement, ())                                                   \
+  V(Rethrow, ())                                                             \
+  V(Throw, ())                                                               \
+  V(Assign, (Token))                                                         \
+  V(Binary, (Token))                                                         \
+  V(Unary, (Token, bool))                                                    \
+  V(Dot, ())                                                                 \
+  V(CascadeReceiver, (Token))                                                \
+  V(Cascade, ())                                                             \
+  V(Invoke, (int, int))                                                      \
+  V(Index, ())                                                               \
+  V(Conditional, ())                                                         \
+  V(Is, (bool))                                                              \
+  V(As, ())                                                                  \
+  V(New, (bool))                                                             \
+  V(FunctionExpression, (int))                                               \
+  V(SymbolPart, (Token, int))                                                \
+  V(Symbol, (int))                                                           \
+  V(Reference, (int))                                                        \
+  V(Identifier, (int, Location))                                             \
+  V(StringReference, (int))                                                  \
+  V(Builtin, (Token))                                                        \
+  V(EmptyStatement, ())                                                      \
+  V(ExpressionStatement, ())                                                 \
+  V(ParenthesizedExpression, (Location))                                     \
+  V(This, ())                                                                \
+  V(Super, ())                                                               \
+  V(Null, ())                                                                \
+  V(Boolean, (bool))                                                         \
+  V(List, (bool, int))                                                       \
+  V(Map, (bool, int))                                                        \
+  V(String, (int))                                                           \
+  V(StringInterpolation, (int))                                              \
 
-  int terminal_ = -1;
-  bool is_keyword_ = false;
+enum BuilderEvent {
+#define DECLARE(name, parameters) k##name##Event,
+BUILDER_EVENT_LIST(DECLARE)
+#undef DECLARE
+  kNumberOfBuilderEvents
+};
+
+// An error found while building a unit. The message is in the zone of
+// the builder that reported it.
+struct Diagnostic {
+  Location location;
+  const char* message;
 };
 
 class Builder : public StackAllocated {
@@ -28,21 +103,69 @@ class Builder : public StackAllocated {
   Zone* zone() const { return zone_; }
   Source* source() { return &source_; }
 
-  TerminalTrieNode* identifier_trie() const { return identifier_root_; }
-  TerminalTrieNode* number_trie() const { return number_root_; }
+  Interner* identifier_interner() { return &identifier_interner_; }
+
+  // Units are scanned through the token cache, if there is one.
+  void set_token_cache(TokenCache* cache) { token_cache_ = cache; }
+
+  // When set, the parser skips the block bodies of methods using the
+  // bracket offsets from the scanner. A skipped body is parsed the first
+  // time MethodNode::body() is called, so the tokens of the unit are kept
+  // in the builder's zone. Method bodies are never skipped in incremental
+  // mode, where the tokens don't outlive the build.
+  void set_lazy_method_bodies(bool value) { lazy_method_bodies_ = value; }
+  bool lazy_method_bodies() const {
+    return lazy_method_bodies_ && !incremental_;
+  }
+
+  // When set, the parser only builds an outline of the unit: method
+  // bodies, field initializers and constructor initializer lists are
+  // skipped. Methods get empty statements as bodies. This is meant for
+  // indexing declarations, not for compiling them.
+  void set_outline(bool value) { outline_ = value; }
+  bool outline() const { return outline_; }
+
+  // Units with enough tokens have their top-level declarations parsed on
+  // up to this many threads. Each thread parses a range of declarations
+  // with its own builder and zone; the zones are adopted by this
+  // builder's zone afterwards.
+  void set_parse_threads(int threads) { parse_threads_ = threads; }
+
+  // When set, the builder remembers the top-level declarations of the
+  // units it builds, so RebuildUnit can reuse them. Units are parsed on
+  // one thread in this mode.
+  void set_incremental(bool value) { incremental_ = value; }
+  bool incremental() const { return incremental_; }
 
   CompilationUnitNode* BuildUnit(Location location);
 
+  // Builds the unit at 'location', which is an edited version of the
+  // source that 'previous' was built from by this builder in incremental
+  // mode. The top-level declarations whose tokens didn't change are
+  // reused and moved to the new source; only the others are parsed.
+  // 'previous' shares the reused nodes, so it must not be used afterwards.
+  CompilationUnitNode* RebuildUnit(CompilationUnitNode* previous,
+                                   Location location);
+
+  // Parses the block at 'position' in the tokens and returns it.
+  TreeNode* ParseLazyBody(TokenColumns tokens, int position);
+
   List<TreeNode*> Nodes();
   List<TreeNode*> Registry() { return registry_.ToList(); }
-  TreeNode* Lookup(int id) { return registry_.Get(id); }
-  const char* LookupIdentifier(int id) { return identifiers_.Get(id); }
-  LiteralStringNode* LookupString(int id) { return string_registry_.Get(id); }
+  List<StringSlice> Identifiers() { return identifiers_.ToList(); }
+  List<LiteralStringNode*> Strings() { return string_registry_.ToList(); }
+  TreeNode* Lookup(int id);
+  StringSlice LookupIdentifier(int id);
+  LiteralStringNode* LookupString(int id);
+  int string_count() const { return string_registry_.length(); }
 
   IdentifierNode* OperatorName(Token token);
   IdentifierNode* BuiltinName(Token token);
 
-  int ComputeCanonicalId(const char* name);
+  int ComputeCanonicalId(StringSlice name);
+  // Numeric literals with the same value share a single registry entry.
+  int ComputeCanonicalIntegerId(i64 value);
+  int ComputeCanonicalDoubleId(double value);
   IdentifierNode* Canonicalize(const char* name);
 
   void DoCompilationUnit(int count);
@@ -61,6 +184,9 @@ class Builder : public StackAllocated {
                 int parameter_count,
                 int initializer_count);
   void DoOperator(Token token, Modifiers modifiers, int parameter_count);
+  // Makes the next method take the unparsed block at 'position' in the
+  // tokens as its body, instead of a body on the stack.
+  void DoLazyBody(TokenColumns tokens, int position);
 
   void DoBlock(int count);
   void DoVariableDeclarationStatement(Modifiers modifiers, int count);
@@ -95,6 +221,11 @@ class Builder : public StackAllocated {
   void DoAs();
   void DoNew(bool is_const);
   void DoFunctionExpression(int parameter_count);
+  // A symbol literal is built as 'const Symbol(name)'. Its parts are the
+  // identifiers and periods of the name; 'id' is the identifier id of an
+  // identifier part.
+  void DoSymbolPart(Token token, int id);
+  void DoSymbol(int part_count);
 
   void DoReference(int id);
   void DoIdentifier(int id, Location location);
@@ -117,24 +248,93 @@ class Builder : public StackAllocated {
 
   int RegisterInteger(i64 value);
   int RegisterDouble(double value);
-  int RegisterIdentifier(const char* value);
-  int RegisterString(const char* value);
+  // The characters of registered identifiers and strings are not
+  // copied; they usually point into the source.
+  int RegisterIdentifier(StringSlice value);
+  int RegisterString(StringSlice value);
+  // Forgets the strings registered after the first 'count' strings.
+  void TruncateStrings(int count);
+  // Registers strings made by another builder whose zone has been adopted
+  // by this builder's zone. Returns the id of the first of them.
+  int AdoptStrings(List<LiteralStringNode*> strings);
 
   void PushIdentifier(IdentifierNode* node) { nodes_.Add(node); }
 
+  // The parser recovers from an error by dropping the nodes it pushed
+  // for the statement, member or declaration it was parsing.
+  int node_count() const { return nodes_.length(); }
+  // Forgets the nodes pushed after the first 'count' nodes, and the lazy
+  // body of a method that wasn't built.
+  void TruncateNodes(int count);
+
+  // Errors don't stop the build. They are collected in the order they
+  // were reported, and the unit is built from what could be parsed.
   void ReportError(Location location, const char* format, ...);
   void ReportError(Location location, const char* format, va_list args);
+  List<Diagnostic> Diagnostics() { return diagnostics_.ToList(); }
+  bool has_errors() const { return !diagnostics_.is_empty(); }
+  int error_count() const { return diagnostics_.length(); }
+  // Prints the errors to stderr with the source lines they are on.
+  void PrintDiagnostics();
+
+#ifdef PARSER_STATISTICS
+  // The statistics of the parsers that built the current unit. Method
+  // bodies that are parsed lazily after the build are not counted.
+  ParserStatistics* statistics();
+#endif
 
  private:
+  struct Shared;
+  struct ParseTask;
+  struct DeclarationRange;
+
+  // Don't split units with fewer tokens per thread than this.
+  static const int kMinimumTokensPerParseThread = 4096;
+
+  // Creates a builder that parses on a worker thread. It looks up and
+  // registers terminals in the builder that is building the unit.
+  Builder(Zone* zone, Shared* shared);
+
+  Shared* const shared_;
   Zone* const zone_;
   Source source_;
-  TerminalTrieNode* const identifier_root_;
-  TerminalTrieNode* const number_root_;
+  Interner identifier_interner_;
+  HashMap<i64, int> integer_ids_;
+  HashMap<u64, int> double_ids_;
   ListBuilder<TreeNode*, 64> nodes_;
   ListBuilder<TreeNode*, 256> registry_;
-  ListBuilder<const char*, 256> identifiers_;
+  ListBuilder<StringSlice, 256> identifiers_;
   ListBuilder<LiteralStringNode*, 256> string_registry_;
-  List<int> builtins_;
+  ListBuilder<Diagnostic, 8> diagnostics_;
+  // The declarations of the units built in incremental mode, and the
+  // nodes with locations made while parsing a range of them.
+  HashMap<CompilationUnitNode*, List<DeclarationRange>> unit_ranges_;
+  ListBuilder<TreeNode*, 64> located_;
+  TokenCache* token_cache_ = NULL;
+  bool lazy_method_bodies_ = false;
+  bool outline_ = false;
+  int parse_threads_ = 1;
+  bool incremental_ = false;
+  LazyBody* lazy_body_ = NULL;
+#ifdef PARSER_STATISTICS
+  ParserStatistics* statistics_ = NULL;
+#endif
+
+  static int BuiltinId(Token token) { return token - kABSTRACT; }
+
+  TreeNode* PopMethodBody(LazyBody** lazy_body);
+
+  CompilationUnitNode* BuildUnit(Location location,
+                                 List<DeclarationRange> previous);
+  TokenColumns ScanTokens(Zone* zone, const char* source, Location location);
+  void ParseUnit(TokenColumns tokens);
+  bool SplitDeclarations(TokenColumns tokens,
+                         ListBuilder<int, 256>* starts,
+                         int* end);
+  List<DeclarationRange> ParseUnitIncrementally(
+      TokenColumns tokens, List<DeclarationRange> previous);
+  u64 HashSource(Location start, Location end);
+  static void* RunParseTask(void* task);
 
   TreeNode* Top() const { return nodes_.last(); }
   TreeNode* Pop() { return nodes_.RemoveLast(); }
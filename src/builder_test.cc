@@ -4,16 +4,21 @@
 
 #define TESTING
 
+#include <stdio.h>
+
 #include "src/assert.h"
 #include "src/builder.h"
+#include "src/os.h"
 #include "src/test_case.h"
 #include "src/pretty_printer.h"
+#include "src/string_buffer.h"
 #include "src/zone.h"
 
 namespace rart {
 
-const char* Build(Zone* zone, const char* source) {
+const char* Build(Zone* zone, const char* source, bool outline = false) {
   Builder builder(zone);
+  builder.set_outline(outline);
   Location location = builder.source()->LoadFromBuffer("<test_source>",
                                                        source,
                                                        strlen(source));
@@ -101,7 +106,24 @@ TEST_CASE(SimpleMethod) {
 TEST_CASE(Canonicalization) {
   Zone zone;
   Builder builder(&zone);
-  EXPECT_STREQ("+", builder.Canonicalize("+")->value());
+  EXPECT_STREQ("+", builder.Canonicalize("+")->value().ToCString(&zone));
+}
+
+TEST_CASE(InvalidUtf8) {
+  Zone zone;
+  Builder builder(&zone);
+  Source* source = builder.source();
+  Location valid = source->LoadFromBuffer("<valid>", "// \xc3\xa9\n", 6);
+  EXPECT(source->FindInvalidUtf8(valid).IsInvalid());
+  // The second file spans chunks; the error is found from any of them.
+  const int kSize = 10000;
+  char* text = static_cast<char*>(zone.Allocate(kSize));
+  memset(text, ' ', kSize);
+  text[5000] = '\xc3';
+  Location invalid = source->LoadFromBuffer("<invalid>", text, kSize);
+  Location error = source->FindInvalidUtf8(invalid + 9000);
+  EXPECT_EQ(invalid.raw() + 5000, error.raw());
+  EXPECT_EQ(text + 5000, source->GetSource(error));
 }
 
 TEST_CASE(SimpleClass) {
@@ -395,6 +417,28 @@ TEST_CASE(Binary) {
       Build(&zone, "x() { return 1 >= 3; }"));
 }
 
+TEST_CASE(OperatorChains) {
+  Zone zone;
+  EXPECT_STREQ(
+      "x(){return ((a-b)-c);}",
+      Build(&zone, "x() { return a - b - c; }"));
+  EXPECT_STREQ(
+      "x(){return a?b:c?d:e;}",
+      Build(&zone, "x() { return a ? b : c ? d : e; }"));
+  EXPECT_STREQ(
+      "x(){return (a||(b&&(c==(d+(e*f)))));}",
+      Build(&zone, "x() { return a || b && c == d + e * f; }"));
+  EXPECT_STREQ(
+      "x(){return a..b()..c=d;}",
+      Build(&zone, "x() { return a..b()..c = d; }"));
+  EXPECT_STREQ(
+      "x(){return (a+b) is int;}",
+      Build(&zone, "x() { return a + b is int; }"));
+  EXPECT_STREQ(
+      "x(){return ((a as int==b)||c is! num);}",
+      Build(&zone, "x() { return a as int == b || c is! num; }"));
+}
+
 TEST_CASE(Index) {
   Zone zone;
   EXPECT_STREQ(
@@ -688,4 +732,414 @@ TEST_CASE(Initializers) {
       Build(&zone, "class A { A() : this._(5); A._(x); }"));
 }
 
+TEST_CASE(LazyMethodBodies) {
+  Zone zone;
+  const char* source =
+      "class A {\n"
+      "  A() : x = 1 { foo({}); }\n"
+      "  get y { return 2; }\n"
+      "  set y(v) { x = v; }\n"
+      "  operator+(o) { return x + o; }\n"
+      "  z() => 3;\n"
+      "  native w() native catch (error) { return error; }\n"
+      "}\n"
+      "main() { var f = () { return 4; }; }\n";
+  const char* eager = Build(&zone, source);
+
+  Builder builder(&zone);
+  builder.set_lazy_method_bodies(true);
+  Location location = builder.source()->LoadFromBuffer("<test_source>",
+                                                       source,
+                                                       strlen(source));
+  CompilationUnitNode* unit = builder.BuildUnit(location);
+  List<TreeNode*> members =
+      unit->declarations()[0]->AsClass()->declarations();
+  EXPECT_EQ(6, members.length());
+  for (int i = 0; i < members.length(); i++) {
+    // Only block bodies are skipped.
+    MethodNode* method = members[i]->AsMethod();
+    EXPECT_EQ(i == 4, method->is_body_parsed());
+  }
+  MethodNode* main = unit->declarations()[1]->AsMethod();
+  EXPECT(!main->is_body_parsed());
+  EXPECT(main->body()->IsBlock());
+  EXPECT(main->is_body_parsed());
+
+  PrettyPrinter printer(&zone);
+  unit->Accept(&printer);
+  EXPECT_STREQ(eager, printer.Output());
+}
+
+TEST_CASE(Outline) {
+  Zone zone;
+  EXPECT_STREQ(
+      "x(a,b);",
+      Build(&zone, "x(a, b) { return a + b; }", true));
+  EXPECT_STREQ(
+      "x({y:5});",
+      Build(&zone, "int x({y: 5}) => y * y;", true));
+  EXPECT_STREQ(
+      "var x,y;",
+      Build(&zone, "var x = [1, 2], y = foo(3, 4);", true));
+  EXPECT_STREQ(
+      "var m,f;",
+      Build(&zone,
+            "var m = <int, List<int>>{1: [2, 3]}, f = (a, b) { };", true));
+  EXPECT_STREQ(
+      "class A {\nvar x;\nA(x);\nget foo;\nset x(v);\n+(o);\n}",
+      Build(&zone,
+            "class A {\n"
+            "  var x = const [1, 2];\n"
+            "  A(x) : this.x = x, super(x, [1, 2]) { print(x); }\n"
+            "  get foo { return x; }\n"
+            "  set x(v) => x = v;\n"
+            "  operator+(o) { return x + o; }\n"
+            "}\n",
+            true));
+}
+
+TEST_CASE(ErrorRecovery) {
+  Zone zone;
+  const char* source =
+      "var x = ;\n"
+      "main() {\n"
+      "  a b c;\n"
+      "  if (x) { c(; } else { d; }\n"
+      "  e;\n"
+      "}\n"
+      "class A {\n"
+      "  var y = [1, 2;\n"
+      "  foo() { f; ) }\n"
+      "  bar() => 1;\n"
+      "}\n"
+      "}\n"
+      "baz() { g; }\n";
+  Builder builder(&zone);
+  Location location = builder.source()->LoadFromBuffer("<test_source>",
+                                                       source,
+                                                       strlen(source));
+  CompilationUnitNode* unit = builder.BuildUnit(location);
+  PrettyPrinter printer(&zone);
+  unit->Accept(&printer);
+  EXPECT_STREQ(
+      "main(){if(x){}else {d;}e;}\n"
+      "class A {\nfoo(){f;}\nbar()=>1;\n}\n"
+      "baz(){g;}",
+      printer.Output());
+
+  // Each error is reported once, at the token where parsing failed.
+  static const int kLines[] = { 1, 3, 4, 8, 9, 12 };
+  static const int kColumns[] = { 9, 7, 14, 16, 14, 1 };
+  List<Diagnostic> diagnostics = builder.Diagnostics();
+  EXPECT(builder.has_errors());
+  EXPECT_EQ(6, diagnostics.length());
+  for (int i = 0; i < diagnostics.length(); i++) {
+    int line = 0;
+    int column = 0;
+    builder.source()->GetLineAndColumn(diagnostics[i].location,
+                                       &line,
+                                       &column);
+    EXPECT_EQ(kLines[i], line);
+    EXPECT_EQ(kColumns[i], column);
+  }
+  EXPECT_STREQ("Expected ';' but found 'identifier'.",
+               diagnostics[1].message);
+}
+
+// Returns the printed unit followed by the lines and columns of the
+// errors.
+static const char* BuildWithThreads(Zone* zone, const char* source,
+                                    int threads) {
+  Builder builder(zone);
+  builder.set_parse_threads(threads);
+  Location location = builder.source()->LoadFromBuffer("<test_source>",
+                                                       source,
+                                                       strlen(source));
+  CompilationUnitNode* unit = builder.BuildUnit(location);
+  PrettyPrinter printer(zone);
+  unit->Accept(&printer);
+  StringBuffer buffer(zone);
+  buffer.Append(StringSlice(printer.Output()));
+  List<Diagnostic> diagnostics = builder.Diagnostics();
+  for (int i = 0; i < diagnostics.length(); i++) {
+    int line = 0;
+    int column = 0;
+    builder.source()->GetLineAndColumn(diagnostics[i].location,
+                                       &line,
+                                       &column);
+    buffer.Print("\n%d:%d: %s", line, column, diagnostics[i].message);
+  }
+  return buffer.ToString();
+}
+
+TEST_CASE(ErrorInLookahead) {
+  // These errors are found while looking ahead for a member start, and
+  // parsing recovers from them like from any other error.
+  Zone zone;
+  const char* source =
+      "class A { Foo<1> x; bar() => 1; }\n"
+      "main() { const Foo<1> x; y; }\n";
+  Builder builder(&zone);
+  Location location = builder.source()->LoadFromBuffer("<test_source>",
+                                                       source,
+                                                       strlen(source));
+  CompilationUnitNode* unit = builder.BuildUnit(location);
+  PrettyPrinter printer(&zone);
+  unit->Accept(&printer);
+  EXPECT_STREQ("class A {\nbar()=>1;\n}\nmain(){y;}", printer.Output());
+  EXPECT_EQ(2, builder.Diagnostics().length());
+}
+
+TEST_CASE(ErrorsAfterLexicalError) {
+  // The scanner skips what it doesn't recognize and goes on, so the
+  // errors after a lexical error are reported too.
+  Zone zone;
+  EXPECT_STREQ(
+      "main(){}\nfoo(){}"
+      "\n1:20: Unrecognized character: 0x60"
+      "\n1:22: Expected ';' but found 'integer'."
+      "\n2:11: Expected ';' but found 'integer'.",
+      BuildWithThreads(&zone,
+                       "main() { var x = 1 ` 2; }\nfoo() { 1 2; }\n",
+                       1));
+  EXPECT_STREQ(
+      "main(){return '\\q \\x1';}\nfoo(){}"
+      "\n1:24: Invalid escape sequence"
+      "\n2:11: Expected ';' but found 'integer'.",
+      BuildWithThreads(&zone,
+                       "main() { return '\\q \\x1'; }\nfoo() { 1 2; }\n",
+                       1));
+  EXPECT_STREQ(
+      "main(){return 'a$';}\nfoo(){}"
+      "\n1:20: Bad string interpolation start"
+      "\n2:11: Expected ';' but found 'integer'.",
+      BuildWithThreads(&zone,
+                       "main() { return 'a$'; }\nfoo() { 1 2; }\n",
+                       1));
+}
+
+static const char* GenerateDeclarations(Zone* zone, int count,
+                                        bool with_errors = false) {
+  StringBuffer buffer(zone);
+  buffer.Print("library test.parallel;\n");
+  for (int i = 0; i < count; i++) {
+    buffer.Print(
+        "@Annotation(%d)\n"
+        "class C%d extends Base<int> {\n"
+        "  var map = {'a': [1, 2]};\n"
+        "  operator +(other) => #symbol%d.name;\n"
+        "  native foo() native catch (error) { return error; }\n"
+        "}\n"
+        "var f%d = (a) { return '${a}$a'; };\n"
+        "var m%d = {} as Map;\n"
+        "int get g%d { return f%d(%d) + -%d.5; }\n",
+        i, i, i, i, i, i, i, i, i);
+    if (with_errors && i % 100 == 50) buffer.Print("h%d() { a b c; }\n", i);
+  }
+  return buffer.ToString();
+}
+
+TEST_CASE(ParallelParse) {
+  Zone zone;
+  const char* source = GenerateDeclarations(&zone, 500);
+  const char* expected = BuildWithThreads(&zone, source, 1);
+  EXPECT_STREQ(expected, BuildWithThreads(&zone, source, 4));
+  EXPECT_STREQ(expected, BuildWithThreads(&zone, source, 3));
+
+  // The errors of all threads are collected in source order.
+  source = GenerateDeclarations(&zone, 500, true);
+  expected = BuildWithThreads(&zone, source, 1);
+  EXPECT(strstr(expected, "Expected ';'") != NULL);
+  EXPECT_STREQ(expected, BuildWithThreads(&zone, source, 4));
+  EXPECT_STREQ(expected, BuildWithThreads(&zone, source, 3));
+}
+
+TEST_CASE(ParallelParseSpeed) {
+  Zone zone;
+  const int REPEAT = 3;
+  const int THREADS = 4;
+  const char* source = GenerateDeclarations(&zone, 10000);
+  size_t length = strlen(source);
+  i64 elapsed[2] = { 0, 0 };
+  for (int i = 0; i < REPEAT; i++) {
+    for (int parallel = 0; parallel < 2; parallel++) {
+      Zone build_zone;
+      Builder builder(&build_zone);
+      builder.set_parse_threads(parallel ? THREADS : 1);
+      Location location = builder.source()->LoadFromBuffer("<speed>",
+                                                           source,
+                                                           length);
+      i64 start = OS::CurrentTime();
+      builder.BuildUnit(location);
+      i64 time = OS::CurrentTime() - start;
+      if (i == 0 || time < elapsed[parallel]) elapsed[parallel] = time;
+    }
+  }
+  if (elapsed[0] <= 0) elapsed[0] = 1;
+  if (elapsed[1] <= 0) elapsed[1] = 1;
+  printf("ParallelParseSpeed: 1 thread %.1f MB/s, %d threads %.1f MB/s\n",
+         static_cast<double>(length) / elapsed[0], THREADS,
+         static_cast<double>(length) / elapsed[1]);
+}
+
+TEST_CASE(TinyUnitSpeed) {
+  // Many small units, each with its own builder, so the time is mostly
+  // spent setting up builders and scanners.
+  const int UNITS = 20000;
+  const char* source = "class A { foo() => 42; }";
+  i64 start = OS::CurrentTime();
+  for (int i = 0; i < UNITS; i++) {
+    Zone zone;
+    Builder builder(&zone);
+    Location location = builder.source()->LoadFromBuffer("<tiny>",
+                                                         source,
+                                                         strlen(source));
+    builder.BuildUnit(location);
+  }
+  i64 elapsed = OS::CurrentTime() - start;
+  if (elapsed <= 0) elapsed = 1;
+  printf("TinyUnitSpeed: %.0f units/s\n",
+         static_cast<double>(UNITS) * 1000000 / elapsed);
+}
+
+static CompilationUnitNode* BuildVersion(Builder* builder,
+                                         CompilationUnitNode* previous,
+                                         const char* path,
+                                         const char* source) {
+  Location location = builder->source()->LoadFromBuffer(path,
+                                                        source,
+                                                        strlen(source));
+  if (previous == NULL) return builder->BuildUnit(location);
+  return builder->RebuildUnit(previous, location);
+}
+
+static const char* Print(Zone* zone, CompilationUnitNode* unit) {
+  PrettyPrinter printer(zone);
+  unit->Accept(&printer);
+  return printer.Output();
+}
+
+TEST_CASE(IncrementalRebuild) {
+  const char* before =
+      "library test.incremental;\n"
+      "class A {\n"
+      "  foo(a) => (a + 1);\n"
+      "}\n"
+      "bar(x) { return x * 2; }\n"
+      "class B {\n"
+      "  baz() { return bar(3); }\n"
+      "}\n";
+  const char* after =
+      "library test.incremental;\n"
+      "class A {\n"
+      "  foo(a) => (a + 1);\n"
+      "}\n"
+      "bar(x) {\n"
+      "  return x * 2 + (x - 1);\n"
+      "}\n"
+      "class B {\n"
+      "  baz() { return bar(3); }\n"
+      "}\n";
+  Zone zone;
+  Builder builder(&zone);
+  builder.set_incremental(true);
+  CompilationUnitNode* first =
+      BuildVersion(&builder, NULL, "before", before);
+  List<TreeNode*> old_declarations = first->declarations();
+  CompilationUnitNode* second =
+      BuildVersion(&builder, first, "after", after);
+  EXPECT_STREQ(Build(&zone, after), Print(&zone, second));
+
+  // Only the edited declaration is parsed again.
+  List<TreeNode*> declarations = second->declarations();
+  EXPECT_EQ(3, declarations.length());
+  EXPECT(declarations[0] == old_declarations[0]);
+  EXPECT(declarations[1] != old_declarations[1]);
+  EXPECT(declarations[2] == old_declarations[2]);
+
+  // The reused declarations are moved to the new source.
+  Source* source = builder.source();
+  ClassNode* a = declarations[0]->AsClass();
+  ParenthesizedNode* body =
+      a->declarations()[0]->AsMethod()->body()->AsParenthesized();
+  EXPECT(body != NULL);
+  EXPECT_STREQ("after", source->GetFilePath(body->location()));
+  Location location = declarations[2]->AsClass()->name()->location();
+  EXPECT_STREQ("after", source->GetFilePath(location));
+  int line = 0;
+  int column = 0;
+  source->GetLineAndColumn(location, &line, &column);
+  EXPECT_EQ(8, line);
+  EXPECT_EQ(7, column);
+
+  // Declarations with errors are parsed again, so the errors are kept.
+  const char* broken =
+      "library test.incremental;\n"
+      "class A {\n"
+      "  foo(a) => (a + 1) 2;\n"
+      "}\n"
+      "bar(x) {\n"
+      "  return x * 2 + (x - 1);\n"
+      "}\n"
+      "class B {\n"
+      "  baz() { return bar(3); }\n"
+      "}\n";
+  CompilationUnitNode* third =
+      BuildVersion(&builder, second, "broken", broken);
+  EXPECT_EQ(1, builder.Diagnostics().length());
+  EXPECT(third->declarations()[1] == declarations[1]);
+  const char* edited =
+      "library test.incremental;\n"
+      "class A {\n"
+      "  foo(a) => (a + 1) 2;\n"
+      "}\n"
+      "bar(x) {\n"
+      "  return x * 2 + (x - 1);\n"
+      "}\n"
+      "class B {\n"
+      "  baz() { return bar(4); }\n"
+      "}\n";
+  BuildVersion(&builder, third, "edited", edited);
+  EXPECT_EQ(2, builder.Diagnostics().length());
+}
+
+TEST_CASE(IncrementalRebuildSpeed) {
+  // Edits one declaration in the middle of units of different sizes.
+  Zone zone;
+  const int REPEAT = 3;
+  const int SIZES = 2;
+  const int declarations[SIZES] = { 1000, 10000 };
+  i64 full[SIZES];
+  i64 rebuild[SIZES];
+  for (int size = 0; size < SIZES; size++) {
+    const char* source = GenerateDeclarations(&zone, declarations[size]);
+    const char* middle = strstr(source + strlen(source) / 2, "return error;");
+    StringBuffer buffer(&zone);
+    buffer.Append(StringSlice(source, middle - source));
+    buffer.Print("return error + 1;");
+    buffer.Append(StringSlice(middle + strlen("return error;")));
+    const char* edited = buffer.ToString();
+    for (int i = 0; i < REPEAT; i++) {
+      Zone build_zone;
+      Builder builder(&build_zone);
+      builder.set_incremental(true);
+      i64 start = OS::CurrentTime();
+      CompilationUnitNode* unit =
+          BuildVersion(&builder, NULL, "<speed>", source);
+      i64 time = OS::CurrentTime() - start;
+      if (i == 0 || time < full[size]) full[size] = time;
+      start = OS::CurrentTime();
+      unit = BuildVersion(&builder, unit, "<speed>", edited);
+      time = OS::CurrentTime() - start;
+      if (i == 0 || time < rebuild[size]) rebuild[size] = time;
+      EXPECT_EQ(declarations[size] * 4, unit->declarations().length());
+    }
+  }
+  printf("IncrementalRebuildSpeed: %d declarations: build %d us, "
+         "rebuild %d us; %d declarations: build %d us, rebuild %d us\n",
+         declarations[0], static_cast<int>(full[0]),
+         static_cast<int>(rebuild[0]), declarations[1],
+         static_cast<int>(full[1]), static_cast<int>(rebuild[1]));
+}
+
 }  // namespace rart
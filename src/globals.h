@@ -107,6 +107,19 @@ const int GB = KB * KB * KB;
   (reinterpret_cast<uword>(&(reinterpret_cast<type*>(kDoubleSize)->field)) - \
      kDoubleSize)
 
+// The expression REPEAT_n(M, start) expands to M(start) M(start + 1)
+// ... M(start + n - 1). It is used for building constant tables with
+// one entry per index from constexpr functions.
+#define REPEAT_4(M, n) M(n) M(n + 1) M(n + 2) M(n + 3)
+#define REPEAT_16(M, n) \
+  REPEAT_4(M, n) REPEAT_4(M, n + 4) REPEAT_4(M, n + 8) REPEAT_4(M, n + 12)
+#define REPEAT_64(M, n) \
+  REPEAT_16(M, n) REPEAT_16(M, n + 16) REPEAT_16(M, n + 32) \
+  REPEAT_16(M, n + 48)
+#define REPEAT_256(M, n) \
+  REPEAT_64(M, n) REPEAT_64(M, n + 64) REPEAT_64(M, n + 128) \
+  REPEAT_64(M, n + 192)
+
 // The USE(x) template is used to silence C++ compiler warnings issued
 // for unused variables.
 template <typename T>
@@ -0,0 +1,85 @@
+// Copyright (c) 2015, the Rart project authors. Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE.md file.
+
+#include <string.h>
+
+#include "src/interner.h"
+#include "src/utils.h"
+
+namespace rart {
+
+Interner::Interner(Zone* zone)
+    : zone_(zone)
+    , table_(AllocateTable(kInitialCapacity))
+    , capacity_(kInitialCapacity)
+    , size_(0) {
+}
+
+Interner::Entry* Interner::Lookup(const char* data, int length, bool copy) {
+  return Lookup(data, length, Utils::StringHash(data, length), copy);
+}
+
+Interner::Entry* Interner::Lookup(const char* data, int length, u32 hash,
+                                  bool copy) {
+  int mask = capacity_ - 1;
+  int index = hash & mask;
+  while (true) {
+    Entry* entry = &table_[index];
+    if (entry->data == NULL) break;
+    if (entry->hash == hash &&
+        entry->length == length &&
+        memcmp(entry->data, data, length) == 0) {
+      return entry;
+    }
+    index = (index + 1) & mask;
+  }
+
+  // Keep the table at most half full, so probe sequences stay short.
+  if (2 * (size_ + 1) > capacity_) {
+    Grow();
+    return Lookup(data, length, hash, copy);
+  }
+
+  if (copy) {
+    char* characters = static_cast<char*>(zone_->Allocate(length + 1));
+    memcpy(characters, data, length);
+    characters[length] = 0;
+    data = characters;
+  }
+
+  Entry* entry = &table_[index];
+  entry->data = data;
+  entry->length = length;
+  entry->hash = hash;
+  size_++;
+  return entry;
+}
+
+Interner::Entry* Interner::AllocateTable(int capacity) {
+  ASSERT(Utils::IsPowerOfTwo(capacity));
+  Entry* table = static_cast<Entry*>(
+      zone_->Allocate(capacity * sizeof(Entry)));
+  for (int i = 0; i < capacity; i++) {
+    table[i].data = NULL;
+    table[i].terminal = -1;
+  }
+  return table;
+}
+
+void Interner::Grow() {
+  Entry* old_table = table_;
+  int old_capacity = capacity_;
+  capacity_ = old_capacity * 2;
+  table_ = AllocateTable(capacity_);
+  int mask = capacity_ - 1;
+  for (int i = 0; i < old_capacity; i++) {
+    Entry* old_entry = &old_table[i];
+    if (old_entry->data == NULL) continue;
+    int index = old_entry->hash & mask;
+    while (table_[index].data != NULL) index = (index + 1) & mask;
+    table_[index] = *old_entry;
+  }
+}
+
+}  // namespace rart
@@ -0,0 +1,64 @@
+// Copyright (c) 2015, the Rart project authors. Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE.md file.
+
+#ifndef SRC_INTERNER_H_
+#define SRC_INTERNER_H_
+
+#include "src/allocation.h"
+#include "src/zone.h"
+
+namespace rart {
+
+// The interner maps strings to a single entry per distinct content. The
+// entries live in one open-addressed table, so a lookup hashes the
+// string once and usually compares it against a single entry.
+class Interner : public StackAllocated {
+ public:
+  struct Entry {
+    // The characters of the string: either a zone-allocated,
+    // zero-terminated copy, or the characters of the first lookup.
+    const char* data;
+    int length;
+    u32 hash;
+    // Slot for the user of the interner; -1 for new entries.
+    int terminal;
+  };
+
+  explicit Interner(Zone* zone);
+
+  // Returns the entry for the given string, adding a new entry if the
+  // string hasn't been seen before. The string does not have to be
+  // zero-terminated. The returned entry is only valid until the next
+  // lookup, because adding entries may move the table. A new entry
+  // copies the string if copy is set; otherwise it refers to the given
+  // characters, which then have to outlive the interner.
+  Entry* Lookup(const char* data, int length, bool copy = true);
+
+  // Same as Lookup, for a string whose hash has already been computed
+  // with Utils::StringHash.
+  Entry* Lookup(const char* data, int length, u32 hash, bool copy);
+
+  // Starts loading the table slot where a lookup of a string with the
+  // given hash begins, for callers that know their next lookups ahead.
+  void Prefetch(u32 hash) const {
+    __builtin_prefetch(&table_[hash & (capacity_ - 1)]);
+  }
+
+  int size() const { return size_; }
+
+ private:
+  static const int kInitialCapacity = 256;
+
+  Zone* const zone_;
+  Entry* table_;
+  int capacity_;
+  int size_;
+
+  Entry* AllocateTable(int capacity);
+  void Grow();
+};
+
+}  // namespace rart
+
+#endif  // SRC_INTERNER_H_
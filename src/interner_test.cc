@@ -0,0 +1,63 @@
+// Copyright (c) 2015, the Rart project authors. Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE.md file.
+
+#define TESTING
+
+#include <stdio.h>
+#include <string.h>
+
+#include "src/assert.h"
+#include "src/interner.h"
+#include "src/test_case.h"
+
+namespace rart {
+
+TEST_CASE(InternerLookup) {
+  Zone zone;
+  Interner interner(&zone);
+  Interner::Entry* foo = interner.Lookup("foobar", 3);
+  EXPECT_STREQ("foo", foo->data);
+  EXPECT_EQ(3, foo->length);
+  EXPECT_EQ(-1, foo->terminal);
+  foo->terminal = 42;
+
+  Interner::Entry* bar = interner.Lookup("bar", 3);
+  EXPECT_EQ(-1, bar->terminal);
+  bar->terminal = 87;
+
+  EXPECT_EQ(42, interner.Lookup("foo", 3)->terminal);
+  EXPECT_EQ(87, interner.Lookup("xbar" + 1, 3)->terminal);
+  EXPECT_EQ(-1, interner.Lookup("fo", 2)->terminal);
+  EXPECT_EQ(-1, interner.Lookup("", 0)->terminal);
+  EXPECT_EQ(4, interner.size());
+
+  // Entries added without copying refer to the first occurrence.
+  const char* source = "bazbaz";
+  Interner::Entry* baz = interner.Lookup(source, 3, false);
+  EXPECT_EQ(source, baz->data);
+  EXPECT_EQ(baz, interner.Lookup(source + 3, 3, false));
+  EXPECT_EQ(5, interner.size());
+}
+
+TEST_CASE(InternerGrow) {
+  Zone zone;
+  Interner interner(&zone);
+  const int SIZE = 10000;
+  char buffer[16];
+  for (int i = 0; i < SIZE; i++) {
+    int length = snprintf(buffer, sizeof(buffer), "x%d", i);
+    Interner::Entry* entry = interner.Lookup(buffer, length);
+    EXPECT_EQ(-1, entry->terminal);
+    entry->terminal = i;
+  }
+  EXPECT_EQ(SIZE, interner.size());
+  for (int i = 0; i < SIZE; i++) {
+    int length = snprintf(buffer, sizeof(buffer), "x%d", i);
+    Interner::Entry* entry = interner.Lookup(buffer, length);
+    EXPECT_EQ(i, entry->terminal);
+    EXPECT_STREQ(buffer, entry->data);
+  }
+}
+
+}  // namespace rart
@@ -0,0 +1,38 @@
+// Copyright (c) 2015, the Rart project authors. Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE.md file.
+
+#ifndef SRC_NUMBER_CONVERSION_H_
+#define SRC_NUMBER_CONVERSION_H_
+
+#include "src/globals.h"
+
+namespace rart {
+
+// Conversion of numeric literals straight from the source text. The
+// input does not have to be zero-terminated and is never copied.
+class NumberConversion {
+ public:
+  // Converts the digits in [start, start + length) in the given base (10
+  // or 16) to an integer. Returns false if the value does not fit in
+  // an i64.
+  static bool ParseInteger(const char* start, int length, int base,
+                           i64* result);
+
+  // Converts a decimal floating point literal of the form
+  // digits [. digits] [(e|E) [+|-] digits] to the nearest double. The
+  // leading digits may be missing if there is a fraction. This uses the
+  // algorithm by Eisel and Lemire and only falls back to strtod for
+  // literals with more than 19 significant digits that it can't round
+  // correctly.
+  static double ParseDouble(const char* start, int length);
+
+ private:
+  // Computes the double nearest to w * 10^q.
+  static double ComputeDouble(u64 w, int q);
+  static double ParseDoubleSlow(const char* start, int length);
+};
+
+}  // namespace rart
+
+#endif  // SRC_NUMBER_CONVERSION_H_
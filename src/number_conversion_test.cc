@@ -0,0 +1,103 @@
+// Copyright (c) 2015, the Rart project authors. Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE.md file.
+
+#define TESTING
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/assert.h"
+#include "src/number_conversion.h"
+#include "src/test_case.h"
+
+namespace rart {
+
+static i64 ParseInteger(const char* input, int base) {
+  i64 result = -1;
+  EXPECT(NumberConversion::ParseInteger(input, strlen(input), base, &result));
+  return result;
+}
+
+static void ExpectSameAsStrtod(const char* input) {
+  double expected = strtod(input, NULL);
+  double actual = NumberConversion::ParseDouble(input, strlen(input));
+  if (bit_cast<u64>(expected) != bit_cast<u64>(actual)) {
+    printf("%s: expected %.17g but was %.17g\n", input, expected, actual);
+  }
+  EXPECT_EQ(bit_cast<u64>(expected), bit_cast<u64>(actual));
+}
+
+TEST_CASE(ParseInteger) {
+  EXPECT_EQ(0, ParseInteger("0", 10));
+  EXPECT_EQ(1234, ParseInteger("1234", 10));
+  EXPECT_EQ(1234, ParseInteger("001234", 10));
+  EXPECT_EQ(0x7f, ParseInteger("7f", 16));
+  EXPECT_EQ(0xABCDEF, ParseInteger("AbCdEf", 16));
+  EXPECT_EQ(INT64_MAX, ParseInteger("9223372036854775807", 10));
+  EXPECT_EQ(INT64_MAX, ParseInteger("7fffffffffffffff", 16));
+
+  i64 result;
+  EXPECT(!NumberConversion::ParseInteger("9223372036854775808", 19, 10,
+                                         &result));
+  EXPECT(!NumberConversion::ParseInteger("8000000000000000", 16, 16,
+                                         &result));
+  EXPECT(!NumberConversion::ParseInteger("123456789012345678901234", 24, 10,
+                                         &result));
+  // The input does not have to be zero-terminated.
+  EXPECT(NumberConversion::ParseInteger("12345", 3, 10, &result));
+  EXPECT_EQ(123, result);
+}
+
+TEST_CASE(ParseDouble) {
+  ExpectSameAsStrtod("0.0");
+  ExpectSameAsStrtod("1.5");
+  ExpectSameAsStrtod(".5");
+  ExpectSameAsStrtod("3.141592653589793");
+  ExpectSameAsStrtod("1e10");
+  ExpectSameAsStrtod("1E+10");
+  ExpectSameAsStrtod("1e-10");
+  ExpectSameAsStrtod("0.1");
+  ExpectSameAsStrtod("0.3");
+  ExpectSameAsStrtod("123456789012345678901234567890.5");
+  ExpectSameAsStrtod("1.7976931348623157e308");
+  ExpectSameAsStrtod("1.7976931348623159e308");
+  ExpectSameAsStrtod("2.2250738585072014e-308");
+  ExpectSameAsStrtod("4.9406564584124654e-324");
+  ExpectSameAsStrtod("2.4703282292062327e-324");
+  ExpectSameAsStrtod("2.4703282292062328e-324");
+  ExpectSameAsStrtod("1e-400");
+  ExpectSameAsStrtod("1e400");
+  ExpectSameAsStrtod("9007199254740993");
+  ExpectSameAsStrtod("9007199254740993.0");
+  ExpectSameAsStrtod("9007199254740992.000000000000000000001");
+  ExpectSameAsStrtod("0.000000000000000000000000000000000000001");
+  ExpectSameAsStrtod("7.3177701707893310e+15");
+  ExpectSameAsStrtod("2.2250738585072011e-308");
+  ExpectSameAsStrtod("1e");
+  ExpectSameAsStrtod("1e99999999999");
+
+  // The input does not have to be zero-terminated.
+  EXPECT_EQ(1.5, NumberConversion::ParseDouble("1.5e10", 3));
+}
+
+TEST_CASE(ParseDoubleRandom) {
+  // Compare against strtod for random digit strings with exponents that
+  // exercise the fast path, Eisel-Lemire and the subnormal range.
+  srand(42);
+  char buffer[64];
+  for (int i = 0; i < 100000; i++) {
+    int digits = 1 + rand() % 25;  // NOLINT
+    int position = 0;
+    for (int j = 0; j < digits; j++) {
+      buffer[position++] = '0' + rand() % 10;  // NOLINT
+      if (j == 0 && digits > 1 && rand() % 2 == 0) buffer[position++] = '.';
+    }
+    int exponent = rand() % 700 - 350;  // NOLINT
+    snprintf(buffer + position, sizeof(buffer) - position, "e%d", exponent);
+    ExpectSameAsStrtod(buffer);
+  }
+}
+
+}  // namespace rart
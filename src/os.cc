@@ -2,7 +2,12 @@
 // for details. All rights reserved. Use of this source code is governed by a
 // BSD-style license that can be found in the LICENSE.md file.
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 
 #include "src/assert.h"
@@ -20,6 +25,10 @@ i64 OS::CurrentTime() {
   return (static_cast<i64>(tv.tv_sec) * 1000000) + tv.tv_usec;
 }
 
+int OS::ProcessId() {
+  return getpid();
+}
+
 static char* AllocateBuffer(Zone* zone, intptr_t length) {
   if (zone == NULL) return reinterpret_cast<char*>(malloc(length));
   return reinterpret_cast<char*>(zone->Allocate(length));
@@ -91,4 +100,35 @@ bool OS::StoreFile(const char* uri, List<u8> bytes) {
   return true;
 }
 
+const void* OS::MapFile(const char* uri, u32* file_size) {
+  int fd = TEMP_FAILURE_RETRY(open(uri, O_RDONLY));
+  if (fd < 0) return NULL;
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    close(fd);
+    return NULL;
+  }
+  void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return NULL;
+  *file_size = info.st_size;
+  return data;
+}
+
+void OS::UnmapFile(const void* data, u32 file_size) {
+  munmap(const_cast<void*>(data), file_size);
+}
+
+bool OS::RenameFile(const char* from, const char* to) {
+  return rename(from, to) == 0;
+}
+
+bool OS::DeleteFile(const char* uri) {
+  return unlink(uri) == 0;
+}
+
+bool OS::CreateDirectory(const char* uri) {
+  return mkdir(uri, 0777) == 0 || errno == EEXIST;
+}
+
 }  // namespace rart
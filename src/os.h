@@ -16,6 +16,8 @@ class OS {
  public:
   static i64 CurrentTime();
 
+  static int ProcessId();
+
   // Resolve 'path' relative to 'uri'.
   // If 'zone' is NULL, malloc is used for allocating the buffer.
   static const char* UriResolve(const char* uri, const char* path, Zone* zone);
@@ -28,6 +30,24 @@ class OS {
 
   // Store file at 'uri'.
   static bool StoreFile(const char* uri, List<u8> bytes);
+
+  // Map the file at 'uri' read-only into memory. Returns NULL without
+  // complaining if the file can't be mapped, since callers use this for
+  // optional files like caches.
+  static const void* MapFile(const char* uri, u32* file_size);
+
+  // Unmap a mapping returned by MapFile. 'file_size' is the size MapFile
+  // returned for it.
+  static void UnmapFile(const void* data, u32 file_size);
+
+  // Replace the file at 'to' with the file at 'from' in one step.
+  static bool RenameFile(const char* from, const char* to);
+
+  // Delete the file at 'uri'.
+  static bool DeleteFile(const char* uri);
+
+  // Create the directory at 'uri', unless it already exists.
+  static bool CreateDirectory(const char* uri);
 };
 
 }  // namespace rart
@@ -2,42 +2,62 @@
 // for details. All rights reserved. Use of this source code is governed by a
 // BSD-style license that can be found in the LICENSE.md file.
 
-#include <cstdlib>
 #include <cstdarg>
 
 #include "src/assert.h"
 #include "src/builder.h"
 #include "src/parser.h"
+#include "src/syntax_builder.h"
+#include "src/utils.h"
 
 namespace rart {
 
-class Lookahead : public StackAllocated {
- public:
-  explicit Lookahead(Parser* parser)
-      : parser_(parser), saved_(parser->stream()->position()) { }
+#ifdef PARSER_STATISTICS
+#define STATISTICS(statement) statement
+#else
+#define STATISTICS(statement)
+#endif
 
-  ~Lookahead() {
-    parser_->stream()->RewindTo(saved_);
-    parser_->RefreshPeek();
-  }
-
- private:
-  Parser* const parser_;
-  const int saved_;
-};
-
-Parser::Parser(Builder* builder, List<TokenInfo> tokens)
+template<typename B>
+BasicParser<B>::BasicParser(B* builder, TokenColumns tokens, int position)
     : builder_(builder)
-    , stream_(tokens) {
+    , tokens_(tokens)
+    , stream_(tokens)
+    , frames_(builder->zone())
+#ifdef PARSER_STATISTICS
+    , events_(builder, statistics_.events)
+#endif
+{
+  stream_.RewindTo(position);
   RefreshPeek();
+  for (int i = 0; i < kMemoSize; i++) memo_[i].position = -1;
 }
 
-void Parser::Advance() {
+#ifdef PARSER_STATISTICS
+template<typename B>
+BasicParser<B>::~BasicParser() {
+  builder_->statistics()->Add(statistics_);
+}
+
+// The parser object is on the stack where parsing starts, so the stack
+// used is the distance from it.
+template<typename B>
+void BasicParser<B>::RecordStackDepth() {
+  char marker;
+  int used = reinterpret_cast<char*>(this) - &marker;
+  statistics_.max_stack = Utils::Maximum(statistics_.max_stack, used);
+}
+#endif
+
+template<typename B>
+void BasicParser<B>::Advance() {
+  STATISTICS(statistics_.tokens++);
   stream_.Advance();
   RefreshPeek();
 }
 
-void Parser::Expect(Token token) {
+template<typename B>
+void BasicParser<B>::Expect(Token token) {
   if (peek_ != token) {
     Error("Expected '%s' but found '%s'.",
           Tokens::Syntax(token),
@@ -46,27 +66,34 @@ void Parser::Expect(Token token) {
   Advance();
 }
 
-bool Parser::Optional(Token token) {
+template<typename B>
+bool BasicParser<B>::Optional(Token token) {
   if (peek_ != token) return false;
   Advance();
   return true;
 }
 
-void Parser::ParseCompilationUnit() {
-  if (Optional(kLIBRARY)) {
-    SkipFullyQualified();
-    Expect(kSEMICOLON);
-  }
-
+template<typename B>
+void BasicParser<B>::ParseCompilationUnit() {
+  ParseWithRecovery(&BasicParser::SkipLibrary);
   int count = 0;
   while (peek_ != kEOF) {
-    ParseToplevelDeclaration();
-    count++;
+    if (ParseWithRecovery(&BasicParser::ParseToplevelDeclaration)) count++;
   }
   builder()->DoCompilationUnit(count);
 }
 
-void Parser::ParseToplevelDeclaration() {
+template<typename B>
+int BasicParser<B>::ParseToplevelDeclarations(int end) {
+  int count = 0;
+  while (peek_ != kEOF && stream_.position() < end) {
+    if (ParseWithRecovery(&BasicParser::ParseToplevelDeclaration)) count++;
+  }
+  return count;
+}
+
+template<typename B>
+void BasicParser<B>::ParseToplevelDeclaration() {
   while (peek_ == kAT) SkipMetadata();
   switch (peek_) {
     case kCLASS:
@@ -96,7 +123,8 @@ void Parser::ParseToplevelDeclaration() {
   }
 }
 
-void Parser::ParseImport() {
+template<typename B>
+void BasicParser<B>::ParseImport() {
   Expect(kIMPORT);
   ParseStringNoInterpolation();
   bool has_prefix = Optional(kAS);
@@ -108,7 +136,8 @@ void Parser::ParseImport() {
   builder()->DoImport(has_prefix, combinator_count);
 }
 
-void Parser::ParseExport() {
+template<typename B>
+void BasicParser<B>::ParseExport() {
   Expect(kEXPORT);
   ParseStringNoInterpolation();
   int combinator_count = ParseCombinators();
@@ -116,7 +145,8 @@ void Parser::ParseExport() {
   builder()->DoExport(combinator_count);
 }
 
-int Parser::ParseCombinators() {
+template<typename B>
+int BasicParser<B>::ParseCombinators() {
   int combinator_count = 0;
   Token token = peek_;
   while (token == kSHOW || token == kHIDE) {
@@ -133,7 +163,8 @@ int Parser::ParseCombinators() {
   return combinator_count;
 }
 
-void Parser::ParsePart() {
+template<typename B>
+void BasicParser<B>::ParsePart() {
   Expect(kPART);
   if (Optional(kOF)) {
     ParseFullyQualified();
@@ -146,7 +177,8 @@ void Parser::ParsePart() {
   builder()->DoPart();
 }
 
-void Parser::ParseClass() {
+template<typename B>
+void BasicParser<B>::ParseClass() {
   bool is_abstract = Optional(kABSTRACT);
   Expect(kCLASS);
   if (peek_ != kIDENTIFIER) {
@@ -170,16 +202,17 @@ void Parser::ParseClass() {
     }
     implements_count = ParseImplements();
     Expect(kLBRACE);
-    while (!Optional(kRBRACE)) {
-      ParseMember();
-      member_count++;
+    while (peek_ != kRBRACE && peek_ != kEOF) {
+      if (ParseWithRecovery(&BasicParser::ParseMember)) member_count++;
     }
+    Expect(kRBRACE);
   }
   builder()->DoClass(
       is_abstract, has_extends, mixins_count, implements_count, member_count);
 }
 
-int Parser::ParseExtends(bool require_with) {
+template<typename B>
+int BasicParser<B>::ParseExtends(bool require_with) {
   ParseQualified();
   SkipOptionalTypeAnnotation();
   int mixins_count = 0;
@@ -194,7 +227,8 @@ int Parser::ParseExtends(bool require_with) {
   return mixins_count;
 }
 
-int Parser::ParseImplements() {
+template<typename B>
+int BasicParser<B>::ParseImplements() {
   int implements_count = 0;
   if (Optional(kIMPLEMENTS)) {
     do {
@@ -206,7 +240,8 @@ int Parser::ParseImplements() {
   return implements_count;
 }
 
-void Parser::ParseTypedef() {
+template<typename B>
+void BasicParser<B>::ParseTypedef() {
   if (PeekIsMemberStart()) {
     ParseMember();
     return;
@@ -220,7 +255,8 @@ void Parser::ParseTypedef() {
   builder()->DoTypedef(parameter_count);
 }
 
-void Parser::ParseMember() {
+template<typename B>
+void BasicParser<B>::ParseMember() {
   while (peek_ == kAT) SkipMetadata();
 
   Modifiers modifiers;
@@ -291,17 +327,26 @@ void Parser::ParseMember() {
   }
 }
 
-void Parser::ParseMethod(Modifiers modifiers) {
+template<typename B>
+void BasicParser<B>::ParseMethod(Modifiers modifiers) {
   int parameter_count = ParseFormalParameters();
   int initializer_count = 0;
   if (peek_ == kCOLON) {
-    initializer_count = ParseInitializers();
+    if (builder()->outline()) {
+      Advance();
+      do {
+        SkipExpression(false);
+      } while (Optional(kCOMMA));
+    } else {
+      initializer_count = ParseInitializers();
+    }
   }
   modifiers = ParseMethodBody(modifiers);
   builder()->DoMethod(modifiers, parameter_count, initializer_count);
 }
 
-void Parser::ParseOperator(Modifiers modifiers) {
+template<typename B>
+void BasicParser<B>::ParseOperator(Modifiers modifiers) {
   Expect(kOPERATOR);
   Token token = kEOF;
   switch (peek_) {
@@ -347,7 +392,8 @@ void Parser::ParseOperator(Modifiers modifiers) {
   builder()->DoOperator(token, modifiers, parameter_count);
 }
 
-Modifiers Parser::ParseMethodBody(Modifiers modifiers) {
+template<typename B>
+Modifiers BasicParser<B>::ParseMethodBody(Modifiers modifiers) {
   if (Optional(kNATIVE)) {
     // TODO(kasperl): Right now, we allow native methods to
     // be on one of two forms:
@@ -364,7 +410,7 @@ Modifiers Parser::ParseMethodBody(Modifiers modifiers) {
         return modifiers;
       }
       int id = stream_.CurrentIndex();
-      if (id != builder()->ComputeCanonicalId("error")) {
+      if (id != builder()->ComputeCanonicalId(StringSlice("error"))) {
         Error("Identifier in native catch block must be named 'error'.");
         return modifiers;
       }
@@ -378,10 +424,31 @@ Modifiers Parser::ParseMethodBody(Modifiers modifiers) {
   }
 
   if (peek_ == kLBRACE) {
-    ParseBlock();
+    // The index of a '{' is the offset to its matching '}'. It is not
+    // positive if the brace is never closed, and then the block is
+    // parsed so the error is reported.
+    int delta = stream_.CurrentIndex();
+    bool outline = builder()->outline();
+    if ((outline || builder()->lazy_method_bodies()) && delta > 0) {
+      if (outline) {
+        builder()->DoEmptyStatement();
+      } else {
+        builder()->DoLazyBody(tokens_, stream_.position());
+      }
+      stream_.Skip(delta);
+      RefreshPeek();
+      Expect(kRBRACE);
+    } else {
+      ParseBlock();
+    }
   } else if (peek_ == kARROW) {
     Advance();
-    ParseExpression();
+    if (builder()->outline()) {
+      SkipExpression(true);
+      builder()->DoEmptyStatement();
+    } else {
+      ParseExpression();
+    }
     Expect(kSEMICOLON);
   } else {
     Expect(kSEMICOLON);
@@ -390,7 +457,8 @@ Modifiers Parser::ParseMethodBody(Modifiers modifiers) {
   return modifiers;
 }
 
-void Parser::ParseFormalParameter(Token token) {
+template<typename B>
+void BasicParser<B>::ParseFormalParameter(Token token) {
   Modifiers modifiers;
   if (peek_ == kVAR) {
     Advance();
@@ -406,7 +474,7 @@ void Parser::ParseFormalParameter(Token token) {
   // Skip function type parameters.
   if (peek_ == kLPAREN) {
     int delta = stream_.CurrentIndex();
-    ASSERT(delta > 0);
+    if (delta <= 0) Error("Unmatched '%s'.", Tokens::Syntax(peek_));
     stream_.Skip(delta);
     RefreshPeek();
     Expect(kRPAREN);
@@ -424,7 +492,8 @@ void Parser::ParseFormalParameter(Token token) {
   }
 }
 
-int Parser::ParseFormalParameters() {
+template<typename B>
+int BasicParser<B>::ParseFormalParameters() {
   int count = 0;
   Expect(kLPAREN);
   while (!Optional(kRPAREN)) {
@@ -449,7 +518,8 @@ int Parser::ParseFormalParameters() {
   return count;
 }
 
-int Parser::ParseInitializers() {
+template<typename B>
+int BasicParser<B>::ParseInitializers() {
   Expect(kCOLON);
   int count = 0;
   do {
@@ -482,18 +552,20 @@ int Parser::ParseInitializers() {
   return count;
 }
 
-void Parser::ParseBlock() {
+template<typename B>
+void BasicParser<B>::ParseBlock() {
   int count = 0;
   Expect(kLBRACE);
   while (peek_ != kRBRACE && peek_ != kEOF) {
-    ParseStatement();
-    count++;
+    if (ParseWithRecovery(&BasicParser::ParseStatement)) count++;
   }
   Expect(kRBRACE);
   builder()->DoBlock(count);
 }
 
-void Parser::ParseStatement() {
+template<typename B>
+void BasicParser<B>::ParseStatement() {
+  STATISTICS(RecordStackDepth());
   switch (peek_) {
     case kLBRACE:
       ParseBlock();
@@ -548,11 +620,9 @@ void Parser::ParseStatement() {
       return;
 
     case kCONST:
-      {
-        // Peek after 'const' and see if it's a member start.
-        Lookahead lookahead(this);
-        Advance();
-        if (!PeekIsMemberStart()) break;
+      if (!LookAhead(kIsConstDeclaration,
+                     &BasicParser::ComputeIsConstDeclaration)) {
+        break;
       }
       ParseVariableDeclarationStatement();
       return;
@@ -630,7 +700,8 @@ void Parser::ParseStatement() {
   builder()->DoExpressionStatement();
 }
 
-void Parser::ParseVariableDeclarationStatement() {
+template<typename B>
+void BasicParser<B>::ParseVariableDeclarationStatement() {
   Modifiers modifiers;
   if (peek_ == kVAR) {
     Advance();
@@ -645,7 +716,8 @@ void Parser::ParseVariableDeclarationStatement() {
   ParseVariableDeclarationStatementRest(modifiers, false);
 }
 
-void Parser::ParseVariableDeclarationStatementRest(
+template<typename B>
+void BasicParser<B>::ParseVariableDeclarationStatementRest(
     Modifiers modifiers,
     bool skip_first) {
   int count = 0;
@@ -653,8 +725,12 @@ void Parser::ParseVariableDeclarationStatementRest(
     if (count > 0 || !skip_first) ParseIdentifier();
     bool has_initializer = false;
     if (Optional(kASSIGN)) {
-      ParseExpression();
-      has_initializer = true;
+      if (builder()->outline()) {
+        SkipExpression(true);
+      } else {
+        ParseExpression();
+        has_initializer = true;
+      }
     }
     count++;
     builder()->DoVariableDeclaration(modifiers, has_initializer);
@@ -663,7 +739,8 @@ void Parser::ParseVariableDeclarationStatementRest(
   builder()->DoVariableDeclarationStatement(modifiers, count);
 }
 
-void Parser::ParseIf() {
+template<typename B>
+void BasicParser<B>::ParseIf() {
   Expect(kIF);
   Expect(kLPAREN);
   ParseExpression();
@@ -677,7 +754,8 @@ void Parser::ParseIf() {
   builder()->DoIf(has_else);
 }
 
-void Parser::ParseFor() {
+template<typename B>
+void BasicParser<B>::ParseFor() {
   Expect(kFOR);
   Expect(kLPAREN);
 
@@ -737,7 +815,8 @@ void Parser::ParseFor() {
   builder()->DoFor(has_condition, count);
 }
 
-void Parser::ParseForInRest(Token token) {
+template<typename B>
+void BasicParser<B>::ParseForInRest(Token token) {
   Expect(kIN);
   ParseExpression();
   Expect(kRPAREN);
@@ -745,7 +824,8 @@ void Parser::ParseForInRest(Token token) {
   builder()->DoForIn(token);
 }
 
-void Parser::ParseWhile() {
+template<typename B>
+void BasicParser<B>::ParseWhile() {
   Expect(kWHILE);
   Expect(kLPAREN);
   ParseExpression();
@@ -754,7 +834,8 @@ void Parser::ParseWhile() {
   builder()->DoWhile();
 }
 
-void Parser::ParseDoWhile() {
+template<typename B>
+void BasicParser<B>::ParseDoWhile() {
   Expect(kDO);
   ParseStatement();
   Expect(kWHILE);
@@ -765,7 +846,8 @@ void Parser::ParseDoWhile() {
   builder()->DoDoWhile();
 }
 
-void Parser::ParseBreak() {
+template<typename B>
+void BasicParser<B>::ParseBreak() {
   Expect(kBREAK);
   bool has_identifier = false;
   if (peek_ != kSEMICOLON) {
@@ -776,7 +858,8 @@ void Parser::ParseBreak() {
   builder()->DoBreak(has_identifier);
 }
 
-void Parser::ParseContinue() {
+template<typename B>
+void BasicParser<B>::ParseContinue() {
   Expect(kCONTINUE);
   bool has_identifier = false;
   if (peek_ != kSEMICOLON) {
@@ -787,7 +870,8 @@ void Parser::ParseContinue() {
   builder()->DoContinue(has_identifier);
 }
 
-void Parser::ParseReturn() {
+template<typename B>
+void BasicParser<B>::ParseReturn() {
   Expect(kRETURN);
   bool has_expression = false;
   if (peek_ != kSEMICOLON) {
@@ -798,7 +882,8 @@ void Parser::ParseReturn() {
   builder()->DoReturn(has_expression);
 }
 
-void Parser::ParseAssert() {
+template<typename B>
+void BasicParser<B>::ParseAssert() {
   Expect(kASSERT);
   Expect(kLPAREN);
   ParseExpression();
@@ -807,7 +892,8 @@ void Parser::ParseAssert() {
   builder()->DoAssert();
 }
 
-void Parser::ParseSwitch() {
+template<typename B>
+void BasicParser<B>::ParseSwitch() {
   Expect(kSWITCH);
   Expect(kLPAREN);
   ParseExpression();
@@ -822,8 +908,7 @@ void Parser::ParseSwitch() {
            peek_ != kDEFAULT &&
            peek_ != kRBRACE &&
            peek_ != kEOF) {
-      ParseStatement();
-      statement_count++;
+      if (ParseWithRecovery(&BasicParser::ParseStatement)) statement_count++;
     }
     builder()->DoCase(statement_count);
     count++;
@@ -833,15 +918,15 @@ void Parser::ParseSwitch() {
     Expect(kCOLON);
     while (peek_ != kRBRACE &&
            peek_ != kEOF) {
-      ParseStatement();
-      statement_count++;
+      if (ParseWithRecovery(&BasicParser::ParseStatement)) statement_count++;
     }
   }
   Expect(kRBRACE);
   builder()->DoSwitch(count, statement_count);
 }
 
-void Parser::ParseTry() {
+template<typename B>
+void BasicParser<B>::ParseTry() {
   Expect(kTRY);
   ParseBlock();
   int catch_count = 0;
@@ -879,7 +964,8 @@ void Parser::ParseTry() {
   builder()->DoTry(catch_count, has_finally);
 }
 
-void Parser::ParseExpression() {
+template<typename B>
+void BasicParser<B>::ParseExpression() {
   if (peek_ == kTHROW) {
     ParseThrow();
   } else {
@@ -887,7 +973,8 @@ void Parser::ParseExpression() {
   }
 }
 
-void Parser::ParseExpressionWithoutCascade() {
+template<typename B>
+void BasicParser<B>::ParseExpressionWithoutCascade() {
   if (peek_ == kTHROW) {
     ParseThrow();
   } else {
@@ -895,98 +982,393 @@ void Parser::ParseExpressionWithoutCascade() {
   }
 }
 
-void Parser::ParseThrow() {
+template<typename B>
+void BasicParser<B>::ParseThrow() {
   Expect(kTHROW);
   ParseExpressionWithoutCascade();
   builder()->DoThrow();
 }
 
-void Parser::ParsePrecedence(int precedence,
-                             bool allow_function,
-                             bool allow_cascade) {
-  ParseUnary(allow_function);
-  Token token = peek_;
-  int next = Tokens::Precedence(token);
-  for (int level = next; level >= precedence; --level) {
-    while (level == next) {
-      if (token == kCASCADE) {
-        if (!allow_cascade) return;
-        ParseCascadeRest();
-      } else if (level == kAssignmentPrecedence) {
-        // Right associative, so we recurse at the same precedence level.
+// The ways an operator can continue an expression after an operand.
+enum InfixKind {
+  kNoInfix,
+  kBinaryInfix,
+  kAssignmentInfix,
+  kCascadeInfix,
+  kPostfixInfix,
+  kConditionalInfix,
+  kIsInfix,
+  kAsInfix
+};
+
+static constexpr InfixKind ClassifyInfix(Token token, int precedence) {
+  return (precedence == 0) ? kNoInfix
+      : (token == kCASCADE) ? kCascadeInfix
+      : (precedence == kAssignmentPrecedence) ? kAssignmentInfix
+      : (precedence == kPostfixPrecedence) ? kPostfixInfix
+      : (token == kCONDITIONAL) ? kConditionalInfix
+      : (token == kIS) ? kIsInfix
+      : (token == kAS) ? kAsInfix
+      : kBinaryInfix;
+}
+
+static const u8 kInfixKinds[] = {
+#define T(n, s, p) ClassifyInfix(n, p),
+TOKEN_LIST(T)
+#undef T
+};
+
+static bool IsPrefixOperator(Token token) {
+  return token == kNOT || token == kSUB || token == kBIT_NOT ||
+      token == kINCREMENT || token == kDECREMENT;
+}
+
+// We don't allow (a == b == c) or (a < b < c), so after one equality or
+// relational operator only operators with lower precedence may follow.
+static int LevelAfter(int level) {
+  bool is_non_associative =
+      level == kEqualityPrecedence || level == kRelationalPrecedence;
+  return is_non_associative ? level - 1 : level;
+}
+
+template<typename B>
+typename BasicParser<B>::PrecedenceFrame BasicParser<B>::NewPrecedenceFrame(
+    int precedence, bool allow_function, bool allow_cascade) {
+  PrecedenceFrame frame;
+  frame.state = kParseOperand;
+  frame.precedence = precedence;
+  frame.level = kPostfixPrecedence;
+  frame.token = kEOF;
+  frame.allow_function = allow_function;
+  frame.allow_cascade = allow_cascade;
+  frame.count = 0;
+  frame.named_count = 0;
+  frame.location = Location();
+  return frame;
+}
+
+template<typename B>
+typename BasicParser<B>::PrecedenceFrame BasicParser<B>::NewBracketFrame(
+    PrecedenceState state, Token token) {
+  PrecedenceFrame frame = NewPrecedenceFrame(0, true, true);
+  frame.state = state;
+  frame.token = token;
+  return frame;
+}
+
+template<typename B>
+void BasicParser<B>::PushFrame(PrecedenceFrame* frame,
+                               PrecedenceState state,
+                               Token token) {
+  frames_.Add(*frame);
+  *frame = NewBracketFrame(state, token);
+}
+
+// Pushes 'frame' and replaces it with a frame for an expression, which
+// may be a throw.
+template<typename B>
+void BasicParser<B>::PushExpression(PrecedenceFrame* frame,
+                                    bool allow_cascade) {
+  frames_.Add(*frame);
+  while (peek_ == kTHROW) {
+    Advance();
+    frames_.Add(NewBracketFrame(kDoThrow, kEOF));
+    allow_cascade = false;
+  }
+  *frame = NewPrecedenceFrame(kAssignmentPrecedence, true, allow_cascade);
+}
+
+template<typename B>
+void BasicParser<B>::ParsePrecedence(int precedence,
+                                     bool allow_function,
+                                     bool allow_cascade) {
+  ParseFrames(NewPrecedenceFrame(precedence, allow_function, allow_cascade));
+}
+
+// Expression parsing with an explicit stack of frames instead of
+// recursion, so long operator chains and deeply nested brackets don't use
+// native stack. A frame parses an operand followed by operators with a
+// precedence between the frame's precedence and its level. An operator
+// that needs an operand parsed at another precedence pushes its frame,
+// and handles the operator when the frame of the operand is done.
+// Parentheses, list and map literals, arguments, index operators and
+// cascades get frames of their own, which push a frame for each
+// expression inside them. The builder events are the same as for the
+// recursive formulation.
+template<typename B>
+void BasicParser<B>::ParseFrames(PrecedenceFrame frame) {
+  int base = frames_.length();
+  while (true) {
+    switch (frame.state) {
+      case kParseOperand:
+        frame.state = kParseOperators;
+        if (IsPrefixOperator(peek_)) {
+          // Right associative, so the operand is parsed at the same
+          // precedence level.
+          frame.token = peek_;
+          frame.state = kDoUnary;
+          Advance();
+          frames_.Add(frame);
+          frame = NewPrecedenceFrame(kPostfixPrecedence, true, true);
+        } else {
+          ParsePrimary(&frame);
+        }
+        continue;
+
+      case kDoUnary:
+        builder()->DoUnary(frame.token, true);
+        frame.state = kParseOperators;
+        continue;
+
+      case kDoBinary:
+        builder()->DoBinary(frame.token);
+        frame.level = LevelAfter(frame.level);
+        frame.state = kParseOperators;
+        continue;
+
+      case kDoAssign:
+        builder()->DoAssign(frame.token);
+        frame.state = kParseOperators;
+        continue;
+
+      case kParseElse:
+        Expect(kCOLON);
+        frame.state = kDoConditional;
+        PushExpression(&frame, false);
+        continue;
+
+      case kDoConditional:
+        builder()->DoConditional();
+        frame.state = kParseOperators;
+        continue;
+
+      case kDoThrow:
+        builder()->DoThrow();
+        frame.state = kPopFrame;
+        continue;
+
+      case kDoParenthesized:
+        Expect(kRPAREN);
+        builder()->DoParenthesizedExpression(frame.location);
+        frame.state = kPopFrame;
+        continue;
+
+      case kDoIndex:
+        Expect(kRBRACK);
+        builder()->DoIndex();
+        frame.state = kPopFrame;
+        continue;
+
+      case kParseArguments:
+        if (Optional(kRPAREN)) {
+          builder()->DoInvoke(frame.count, frame.named_count);
+          if (frame.token != kEOF) builder()->DoNew(frame.token == kCONST);
+          frame.state = kPopFrame;
+          continue;
+        }
+        // Once there is a named argument, the rest are named too.
+        if (frame.named_count > 0 || PeekIsNamedArgument()) {
+          if (frame.count != 0) Expect(kCOMMA);
+          ParseIdentifier();
+          Expect(kCOLON);
+          frame.named_count++;
+        } else if (frame.count != 0) {
+          Expect(kCOMMA);
+        }
+        frame.count++;
+        PushExpression(&frame, true);
+        continue;
+
+      case kParseElement:
+        if (peek_ == kRBRACK) {
+          frame.state = kDoList;
+          continue;
+        }
+        frame.count++;
+        frame.state = kParseElementRest;
+        PushExpression(&frame, true);
+        continue;
+
+      case kParseElementRest:
+        frame.state = Optional(kCOMMA) ? kParseElement : kDoList;
+        continue;
+
+      case kDoList:
+        Expect(kRBRACK);
+        builder()->DoList(frame.token == kCONST, frame.count);
+        frame.state = kPopFrame;
+        continue;
+
+      case kParseEntry:
+        if (peek_ == kRBRACE) {
+          frame.state = kDoMap;
+          continue;
+        }
+        frame.state = kParseEntryValue;
+        PushExpression(&frame, true);
+        continue;
+
+      case kParseEntryValue:
+        Expect(kCOLON);
+        frame.count++;
+        frame.state = kParseEntryRest;
+        PushExpression(&frame, true);
+        continue;
+
+      case kParseEntryRest:
+        frame.state = Optional(kCOMMA) ? kParseEntry : kDoMap;
+        continue;
+
+      case kDoMap:
+        Expect(kRBRACE);
+        builder()->DoMap(frame.token == kCONST, frame.count);
+        frame.state = kPopFrame;
+        continue;
+
+      case kParseCascade: {
+        Expect(kCASCADE);
+        Token token = peek_;
+        builder()->DoCascadeReceiver(token);
+        frame.state = kParseCascadeRest;
+        if (Tokens::IsIdentifier(token)) {
+          ParseIdentifier();
+          builder()->DoDot();
+        } else if (token == kLBRACK) {
+          ParsePostfix(&frame);
+        } else {
+          Error("Expected identifier or '[' in cascade but found '%s'",
+                Tokens::Syntax(token));
+        }
+        continue;
+      }
+
+      case kParseCascadeRest: {
+        Token token = peek_;
+        if (token == kPERIOD || token == kLBRACK || token == kLPAREN) {
+          ParsePostfix(&frame);
+        } else if (Tokens::Precedence(token) == kAssignmentPrecedence) {
+          Advance();
+          frame.token = token;
+          frame.state = kDoCascadeAssign;
+          PushExpression(&frame, false);
+        } else {
+          builder()->DoCascade();
+          frame.state = kPopFrame;
+        }
+        continue;
+      }
+
+      case kDoCascadeAssign:
+        builder()->DoAssign(frame.token);
+        builder()->DoCascade();
+        frame.state = kPopFrame;
+        continue;
+
+      case kPopFrame:
+        // This frame is done, so continue with the one it was pushed by.
+        if (frames_.length() == base) return;
+        frame = frames_.RemoveLast();
+        continue;
+
+      case kParseOperators:
+        break;
+    }
+
+    Token token = peek_;
+    int level = Tokens::Precedence(token);
+    InfixKind kind = static_cast<InfixKind>(kInfixKinds[token]);
+    if (level < frame.precedence || level > frame.level ||
+        (kind == kCascadeInfix && !frame.allow_cascade)) {
+      frame.state = kPopFrame;
+      continue;
+    }
+
+    frame.level = level;
+    switch (kind) {
+      case kAssignmentInfix:
+        // Right associative, so the operand is parsed at the same
+        // precedence level.
         Advance();
-        ParsePrecedence(level, allow_function, allow_cascade);
-        builder()->DoAssign(token);
-      } else if (level == kPostfixPrecedence) {
-        ParsePostfixRest();
-      } else if (token == kCONDITIONAL) {
-        ParseConditionalRest();
-      } else if (token == kIS) {
-        ParseIsRest();
-      } else if (token == kAS) {
-        ParseAsRest();
-      } else {
+        frame.token = token;
+        frame.state = kDoAssign;
+        frames_.Add(frame);
+        frame = NewPrecedenceFrame(level,
+                                   frame.allow_function,
+                                   frame.allow_cascade);
+        continue;
+
+      case kBinaryInfix:
         // Rewrite kGT_START into kSHR.
         if (token == kGT_START) {
           Advance();
           token = kSHR;
         }
-        // Left associative, so we recurse at the next higher
+        // Left associative, so the operand is parsed at the next higher
         // precedence level.
         Advance();
-        ParsePrecedence(level + 1);
-        builder()->DoBinary(token);
-      }
-      token = peek_;
-      next = Tokens::Precedence(token);
-      // We don't allow (a == b == c) or (a < b < c) so we ontinue the outer
-      // loop if we have matched one equality or relational operator.
-      if (level == kEqualityPrecedence || level == kRelationalPrecedence) {
+        frame.token = token;
+        frame.state = kDoBinary;
+        frames_.Add(frame);
+        frame = NewPrecedenceFrame(level + 1, true, true);
+        continue;
+
+      case kConditionalInfix:
+        Advance();
+        frame.state = kParseElse;
+        PushExpression(&frame, false);
+        continue;
+
+      case kCascadeInfix:
+        PushFrame(&frame, kParseCascade, kEOF);
+        continue;
+
+      case kPostfixInfix:
+        ParsePostfix(&frame);
+        continue;
+
+      case kIsInfix:
+        ParseIsRest();
+        break;
+
+      case kAsInfix:
+        ParseAsRest();
+        break;
+
+      case kNoInfix:
+        UNREACHABLE();
         break;
-      }
     }
+    frame.level = LevelAfter(level);
   }
 }
 
-void Parser::ParseCascadeRest() {
-  Expect(kCASCADE);
-  Token token = peek_;
-  builder()->DoCascadeReceiver(token);
-  if (Tokens::IsIdentifier(token)) {
-    ParseIdentifier();
-    builder()->DoDot();
-  } else if (token == kLBRACK) {
-    ParseIndexRest();
-  } else {
-    Error("Expected identifier or '[' in cascade but found '%s'",
-          Tokens::Syntax(token));
-  }
-  token = peek_;
-  while (token == kPERIOD ||
-         token == kLBRACK ||
-         token == kLPAREN) {
-    ParsePostfixRest();
-    token = peek_;
-  }
-  if (Tokens::Precedence(token) == kAssignmentPrecedence) {
-    Advance();
-    ParseExpressionWithoutCascade();
-    builder()->DoAssign(token);
-  }
-  builder()->DoCascade();
+template<typename B>
+void BasicParser<B>::ParseCascadeRest() {
+  ParseFrames(NewBracketFrame(kParseCascade, kEOF));
 }
 
-void Parser::ParsePostfixRest() {
+template<typename B>
+void BasicParser<B>::ParseInvokeRest() {
+  if (peek_ != kLPAREN) Error("Expected '('");
+  Advance();
+  ParseFrames(NewBracketFrame(kParseArguments, kEOF));
+}
+
+template<typename B>
+void BasicParser<B>::ParsePostfix(PrecedenceFrame* frame) {
   Token token = peek_;
   ASSERT(Tokens::Precedence(token) == kPostfixPrecedence);
   if (token == kLPAREN) {
-    ParseInvokeRest();
+    Advance();
+    PushFrame(frame, kParseArguments, kEOF);
   } else if (token == kPERIOD) {
     Advance();
     ParseIdentifier();
     builder()->DoDot();
   } else if (token == kLBRACK) {
-    ParseIndexRest();
+    Advance();
+    PushFrame(frame, kDoIndex, kEOF);
+    PushExpression(frame, true);
   } else {
     ASSERT(token == kINCREMENT || token == kDECREMENT);
     Advance();
@@ -994,15 +1376,8 @@ void Parser::ParsePostfixRest() {
   }
 }
 
-void Parser::ParseConditionalRest() {
-  Expect(kCONDITIONAL);
-  ParseExpressionWithoutCascade();
-  Expect(kCOLON);
-  ParseExpressionWithoutCascade();
-  builder()->DoConditional();
-}
-
-void Parser::ParseIsRest() {
+template<typename B>
+void BasicParser<B>::ParseIsRest() {
   Expect(kIS);
   bool is_not = Optional(kNOT);
   ParseQualified();
@@ -1010,67 +1385,17 @@ void Parser::ParseIsRest() {
   builder()->DoIs(is_not);
 }
 
-void Parser::ParseAsRest() {
+template<typename B>
+void BasicParser<B>::ParseAsRest() {
   Expect(kAS);
   ParseQualified();
   SkipOptionalTypeAnnotation();
   builder()->DoAs();
 }
 
-void Parser::ParseInvokeRest() {
-  if (peek_ != kLPAREN) Error("Expected '('");
-  int count = 0;
-  int named_count = 0;
-  Expect(kLPAREN);
-  while (!Optional(kRPAREN)) {
-    if (PeekIsNamedArgument()) {
-      while (!Optional(kRPAREN)) {
-        if (count != 0) Expect(kCOMMA);
-        ParseIdentifier();
-        Expect(kCOLON);
-        ParseExpression();
-        count++;
-        named_count++;
-      }
-      break;
-    }
-    if (count != 0) Expect(kCOMMA);
-    ParseExpression();
-    count++;
-  }
-  // TODO(ajohnsen): Add named arguments.
-  builder()->DoInvoke(count, named_count);
-}
-
-void Parser::ParseIndexRest() {
-  ASSERT(peek_ == kLBRACK);
-  Advance();
-  ParseExpression();
-  Expect(kRBRACK);
-  builder()->DoIndex();
-}
-
-void Parser::ParseUnary(bool allow_function) {
-  Token token = peek_;
-  switch (token) {
-    case kNOT:        // !
-    case kSUB:        // -
-    case kBIT_NOT:    // ~
-    case kINCREMENT:  // ++
-    case kDECREMENT:  // --
-      // Right associative, so we recurse at the same precedence level.
-      Advance();
-      ParsePrecedence(kPostfixPrecedence);
-      builder()->DoUnary(token, true);
-      break;
-
-    default:
-      ParsePrimary(allow_function);
-      break;
-  }
-}
-
-void Parser::ParsePrimary(bool allow_function) {
+template<typename B>
+void BasicParser<B>::ParsePrimary(PrecedenceFrame* frame) {
+  STATISTICS(RecordStackDepth());
   switch (peek_) {
     case kIDENTIFIER:
       ParseIdentifier();
@@ -1101,20 +1426,13 @@ void Parser::ParsePrimary(bool allow_function) {
 
     case kLT:
       SkipOptionalTypeAnnotation();
-      if (peek_ == kLBRACE) {
-        ParseMap(true, false);
-      } else {
-        ParseList(true, false);
-      }
+      ParseLiteral(frame, false);
       break;
 
     case kLBRACE:
-      ParseMap(false, false);
-      break;
-
     case kINDEX:
     case kLBRACK:
-      ParseList(false, false);
+      ParseLiteral(frame, false);
       break;
 
     case kFALSE:
@@ -1139,23 +1457,20 @@ void Parser::ParsePrimary(bool allow_function) {
       break;
 
     case kLPAREN:
-      if (allow_function && IsFunctionExpression()) {
+      if (frame->allow_function && IsFunctionExpression()) {
         ParseFunctionExpression();
       } else {
         Location location = stream_.CurrentLocation();
         Advance();
-        ParseExpression();
-        Expect(kRPAREN);
-        builder()->DoParenthesizedExpression(location);
+        PushFrame(frame, kDoParenthesized, kEOF);
+        frame->location = location;
+        PushExpression(frame, true);
       }
       break;
 
     case kNEW:
-      ParseNew(false);
-      break;
-
     case kCONST:
-      ParseNew(true);
+      ParseNew(frame);
       break;
 
     case kINTEGER:
@@ -1181,31 +1496,28 @@ void Parser::ParsePrimary(bool allow_function) {
   }
 }
 
-void Parser::ParseNew(bool is_const) {
-  ASSERT((is_const && (peek_ == kCONST)) || (!is_const && (peek_ == kNEW)));
+template<typename B>
+void BasicParser<B>::ParseNew(PrecedenceFrame* frame) {
+  Token token = peek_;
+  ASSERT(token == kNEW || token == kCONST);
   Advance();
 
-  if (is_const) {
-    bool typed = false;
-    if (peek_ == kLT) {
-      SkipOptionalTypeAnnotation();
-      typed = true;
-    }
-    if (peek_ == kLBRACK || peek_ == kINDEX) {
-      ParseList(typed, true);
-      return;
-    } else if (peek_ == kLBRACE) {
-      ParseMap(typed, true);
+  if (token == kCONST) {
+    if (peek_ == kLT) SkipOptionalTypeAnnotation();
+    if (peek_ == kLBRACK || peek_ == kINDEX || peek_ == kLBRACE) {
+      ParseLiteral(frame, true);
       return;
     }
   }
 
   ParseFullyQualified();
-  ParseInvokeRest();
-  builder()->DoNew(is_const);
+  if (peek_ != kLPAREN) Error("Expected '('");
+  Advance();
+  PushFrame(frame, kParseArguments, token);
 }
 
-void Parser::ParseFunctionExpression() {
+template<typename B>
+void BasicParser<B>::ParseFunctionExpression() {
   int count = ParseFormalParameters();
   if (peek_ == kLBRACE) {
     ParseBlock();
@@ -1216,7 +1528,8 @@ void Parser::ParseFunctionExpression() {
   builder()->DoFunctionExpression(count);
 }
 
-void Parser::ParseIdentifier() {
+template<typename B>
+void BasicParser<B>::ParseIdentifier() {
   if (!Tokens::IsIdentifier(peek_)) {
     Error("Expected identifier but found '%s'.", Tokens::Syntax(peek_));
   }
@@ -1228,7 +1541,8 @@ void Parser::ParseIdentifier() {
   Advance();
 }
 
-void Parser::ParseQualified() {
+template<typename B>
+void BasicParser<B>::ParseQualified() {
   ParseIdentifier();
   if (Optional(kPERIOD)) {
     ParseIdentifier();
@@ -1236,7 +1550,8 @@ void Parser::ParseQualified() {
   }
 }
 
-void Parser::ParseFullyQualified() {
+template<typename B>
+void BasicParser<B>::ParseFullyQualified() {
   // TODO(ajohnsen): Use just one node?
   ParseIdentifier();
   SkipOptionalTypeAnnotation();
@@ -1247,52 +1562,38 @@ void Parser::ParseFullyQualified() {
   }
 }
 
-void Parser::ParseList(bool typed, bool is_const) {
-  if (peek_ == kINDEX) {
+// Parses a list or map literal, after its type arguments.
+template<typename B>
+void BasicParser<B>::ParseLiteral(PrecedenceFrame* frame, bool is_const) {
+  Token token = is_const ? kCONST : kEOF;
+  if (peek_ == kLBRACE) {
+    Advance();
+    PushFrame(frame, kParseEntry, token);
+  } else if (peek_ == kINDEX) {
     Advance();
     builder()->DoList(is_const, 0);
-    return;
+  } else {
+    Expect(kLBRACK);
+    PushFrame(frame, kParseElement, token);
   }
-  ASSERT(peek_ == kLBRACK);
-  Advance();
-  int count = 0;
-  do {
-    if (peek_ == kRBRACK) break;
-    ParseExpression();
-    count++;
-  } while (Optional(kCOMMA));
-  Expect(kRBRACK);
-  builder()->DoList(is_const, count);
 }
 
-void Parser::ParseMap(bool typed, bool is_const) {
-  ASSERT(peek_ == kLBRACE);
-  Advance();
-  int count = 0;
-  do {
-    if (peek_ == kRBRACE) break;
-    ParseExpression();
-    Expect(kCOLON);
-    ParseExpression();
-    count++;
-  } while (Optional(kCOMMA));
-  Expect(kRBRACE);
-  builder()->DoMap(is_const, count);
-}
-
-void Parser::ParseInteger() {
+template<typename B>
+void BasicParser<B>::ParseInteger() {
   ASSERT(peek_ == kINTEGER);
   builder()->DoReference(stream_.CurrentIndex());
   Advance();
 }
 
-void Parser::ParseDouble() {
+template<typename B>
+void BasicParser<B>::ParseDouble() {
   ASSERT(peek_ == kDOUBLE);
   builder()->DoReference(stream_.CurrentIndex());
   Advance();
 }
 
-void Parser::ParseStringNoInterpolation() {
+template<typename B>
+void BasicParser<B>::ParseStringNoInterpolation() {
   ASSERT(peek_ == kSTRING);
   int count = 0;
   while (peek_ == kSTRING) {
@@ -1303,7 +1604,8 @@ void Parser::ParseStringNoInterpolation() {
   builder()->DoString(count);
 }
 
-void Parser::ParseString() {
+template<typename B>
+void BasicParser<B>::ParseString() {
   ASSERT(peek_ == kSTRING_INTERPOLATION || peek_ == kSTRING);
   int string_count = 0;
   int count = 0;
@@ -1338,33 +1640,23 @@ void Parser::ParseString() {
   }
 }
 
-void Parser::ParseSymbolLiteral() {
+template<typename B>
+void BasicParser<B>::ParseSymbolLiteral() {
   Expect(kHASH);
-  builder()->PushIdentifier(builder()->Canonicalize("Symbol"));
   int count = 0;
   while (Tokens::IsIdentifier(peek_)) {
-    const char* value;
-    if (peek_ == kIDENTIFIER) {
-      int id = stream_.CurrentIndex();
-      value = builder()->LookupIdentifier(id);
-    } else {
-      value = Tokens::Syntax(peek_);
-    }
-    int id = builder()->RegisterString(value);
-    builder()->DoStringReference(id);
+    builder()->DoSymbolPart(peek_, stream_.CurrentIndex());
     Advance();
     count++;
     if (!Optional(kPERIOD)) break;
-    id = builder()->RegisterString(builder()->Canonicalize(".")->value());
-    builder()->DoStringReference(id);
+    builder()->DoSymbolPart(kPERIOD, 0);
     count++;
   }
-  builder()->DoString(count);
-  builder()->DoInvoke(1, 0);
-  builder()->DoNew(true);
+  builder()->DoSymbol(count);
 }
 
-void Parser::SkipOptionalType() {
+template<typename B>
+void BasicParser<B>::SkipOptionalType() {
   if (peek_ == kVOID) {
     Advance();
   } else {
@@ -1376,7 +1668,8 @@ void Parser::SkipOptionalType() {
   }
 }
 
-void Parser::SkipType() {
+template<typename B>
+void BasicParser<B>::SkipType() {
   if (Optional(kVOID) || Optional(kDYNAMIC)) {
     return;
   } else {
@@ -1390,20 +1683,23 @@ void Parser::SkipType() {
   }
 }
 
-void Parser::SkipQualified() {
+template<typename B>
+void BasicParser<B>::SkipQualified() {
   SkipIdentifier();
   if (Optional(kPERIOD)) {
     SkipIdentifier();
   }
 }
 
-void Parser::SkipFullyQualified() {
+template<typename B>
+void BasicParser<B>::SkipFullyQualified() {
   do {
     SkipIdentifier();
   } while (Optional(kPERIOD));
 }
 
-void Parser::SkipIdentifier() {
+template<typename B>
+void BasicParser<B>::SkipIdentifier() {
   if (Tokens::IsIdentifier(peek_)) {
     Advance();
   } else {
@@ -1411,36 +1707,158 @@ void Parser::SkipIdentifier() {
   }
 }
 
-void Parser::SkipOptionalTypeAnnotation() {
+template<typename B>
+void BasicParser<B>::SkipOptionalTypeAnnotation() {
   if (peek_ == kLT) {
     int delta = stream_.CurrentIndex();
-    ASSERT(delta > 0);
+    if (delta <= 0) Error("Unmatched '%s'.", Tokens::Syntax(peek_));
     stream_.Skip(delta);
     RefreshPeek();
     Expect(kGT);
   }
 }
 
-void Parser::SkipMetadata() {
+template<typename B>
+void BasicParser<B>::SkipLibrary() {
+  if (Optional(kLIBRARY)) {
+    SkipFullyQualified();
+    Expect(kSEMICOLON);
+  }
+}
+
+// Skips a top-level declaration without building anything, so the
+// declarations of a unit can be found before they are parsed. Parentheses
+// and braces are jumped over using their bracket offsets. A declaration
+// ends with a ';' or with a '}' that is followed by something that starts
+// a declaration. Returns false if the declaration doesn't end or has
+// unmatched brackets; parsing it reports the error.
+template<typename B>
+bool BasicParser<B>::SkipToplevelDeclaration() {
+  while (peek_ != kEOF) {
+    Token token = peek_;
+    if (token == kRPAREN || token == kRBRACE) return false;
+    if (token == kLPAREN || token == kLBRACE) {
+      int delta = stream_.CurrentIndex();
+      if (delta <= 0) return false;
+      stream_.Skip(delta);
+    }
+    Advance();
+    if (token == kSEMICOLON) return true;
+    if (token == kLBRACE) {
+      // Only 'as' can follow an expression and look like a declaration.
+      if (peek_ == kEOF || peek_ == kAT || peek_ == kCLASS ||
+          peek_ == kVAR || peek_ == kFINAL || peek_ == kCONST ||
+          peek_ == kVOID || (Tokens::IsIdentifier(peek_) && peek_ != kAS)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+template<typename B>
+void BasicParser<B>::SkipMetadata() {
   Expect(kAT);
   SkipFullyQualified();
   if (peek_ == kLPAREN) SkipFormalParameters();
 }
 
-void Parser::SkipFormalParameters() {
+template<typename B>
+void BasicParser<B>::SkipFormalParameters() {
   ASSERT(peek_ == kLPAREN);
   int delta = stream_.CurrentIndex();
+  if (delta <= 0) Error("Unmatched '('.");
   stream_.Skip(delta);
   RefreshPeek();
   ASSERT(peek_ == kRPAREN);
   Advance();
 }
 
-Token Parser::PeekAfterType() {
+// Skips to the next ',', ';' or closing bracket outside brackets. The
+// scanner has matched parentheses, braces and type arguments, so they are
+// jumped over; square brackets are not matched, so they are counted. If
+// functions are not allowed, '{' and '=>' also end the expression, like
+// they end a constructor initializer list.
+template<typename B>
+void BasicParser<B>::SkipExpression(bool allow_function) {
+  int depth = 0;
+  while (peek_ != kEOF) {
+    if (depth == 0) {
+      if (peek_ == kCOMMA || peek_ == kSEMICOLON) return;
+      if (peek_ == kRPAREN || peek_ == kRBRACE || peek_ == kRBRACK) return;
+      if (!allow_function && (peek_ == kLBRACE || peek_ == kARROW)) return;
+    }
+    if (peek_ == kLPAREN || peek_ == kLBRACE || peek_ == kLT) {
+      int delta = stream_.CurrentIndex();
+      if (delta > 0) stream_.Skip(delta);
+    } else if (peek_ == kLBRACK) {
+      depth++;
+    } else if (peek_ == kRBRACK) {
+      depth--;
+    }
+    Advance();
+  }
+}
+
+template<typename B>
+template<typename T>
+T BasicParser<B>::Memoize(LookaheadQuery query,
+                          T (BasicParser::*compute)()) {
+  MemoEntry* entry = MemoEntryFor(query);
+  if (entry->position == stream_.position() && entry->query == query) {
+    STATISTICS(statistics_.queries[query]++);
+    STATISTICS(statistics_.hits[query]++);
+    STATISTICS(statistics_.saved[query] += entry->distance);
+    return static_cast<T>(entry->answer);
+  }
+  STATISTICS(int walked = statistics_.lookahead_tokens);
+  T answer = LookAhead(query, compute);
+  // Nested queries may have reused the entry, so look it up again.
+  entry = MemoEntryFor(query);
+  entry->position = stream_.position();
+  entry->query = query;
+  entry->answer = answer;
+  STATISTICS(entry->distance =
+      Utils::Minimum(statistics_.lookahead_tokens - walked, 0xFFFF));
+  return answer;
+}
+
+// Answers a query by walking the tokens with 'walk', and rewinds to where
+// the walk started. There is nothing to undo if the walk reports an error,
+// because the recovery point rewinds the stream itself.
+template<typename B>
+template<typename T>
+T BasicParser<B>::LookAhead(LookaheadQuery query,
+                            T (BasicParser::*walk)()) {
+  STATISTICS(statistics_.queries[query]++);
+  int saved = stream_.position();
+  T answer = (this->*walk)();
+  STATISTICS(int walked = stream_.position() - saved);
+  STATISTICS(statistics_.lookahead_tokens += walked);
+  STATISTICS(statistics_.walked[query] += walked);
+  stream_.RewindTo(saved);
+  RefreshPeek();
+  return answer;
+}
+
+template<typename B>
+typename BasicParser<B>::MemoEntry* BasicParser<B>::MemoEntryFor(
+    LookaheadQuery query) {
+  // Consecutive positions map to different entries.
+  int index = (stream_.position() * 5 + query) & (kMemoSize - 1);
+  return &memo_[index];
+}
+
+template<typename B>
+Token BasicParser<B>::PeekAfterType() {
+  return Memoize(kPeekAfterType, &BasicParser::ComputePeekAfterType);
+}
+
+template<typename B>
+Token BasicParser<B>::ComputePeekAfterType() {
   if (peek_ != kIDENTIFIER && peek_ != kDYNAMIC && peek_ != kNATIVE) {
     return kEOF;
   }
-  Lookahead lookahead(this);
   Advance();
   if (peek_ == kPERIOD) {
     Advance();
@@ -1458,12 +1876,19 @@ Token Parser::PeekAfterType() {
   return peek_;
 }
 
-Token Parser::PeekAfterFormalParameters() {
+template<typename B>
+Token BasicParser<B>::PeekAfterFormalParameters() {
+  return Memoize(kPeekAfterFormalParameters,
+                 &BasicParser::ComputePeekAfterFormalParameters);
+}
+
+template<typename B>
+Token BasicParser<B>::ComputePeekAfterFormalParameters() {
   ASSERT(Tokens::IsIdentifier(peek_));
-  Lookahead lookahead(this);
   SkipQualified();
   if (peek_ != kLPAREN) return kEOF;
   int delta = stream_.CurrentIndex();
+  if (delta <= 0) return kEOF;
   stream_.Skip(delta);
   RefreshPeek();
   ASSERT(peek_ == kRPAREN);
@@ -1471,29 +1896,50 @@ Token Parser::PeekAfterFormalParameters() {
   return peek_;
 }
 
-Token Parser::PeekAfterIdentifier() {
+template<typename B>
+Token BasicParser<B>::PeekAfterIdentifier() {
+  return LookAhead(kPeekAfterIdentifier, &BasicParser::ComputePeekAfterIdentifier);
+}
+
+template<typename B>
+Token BasicParser<B>::ComputePeekAfterIdentifier() {
   ASSERT(Tokens::IsIdentifier(peek_));
-  Lookahead lookahead(this);
   Advance();
   return peek_;
 }
 
-Token Parser::PeekNext() {
-  Lookahead lookahead(this);
+template<typename B>
+Token BasicParser<B>::PeekNext() {
+  return LookAhead(kPeekNext, &BasicParser::ComputePeekNext);
+}
+
+template<typename B>
+Token BasicParser<B>::ComputePeekNext() {
   Advance();
   return peek_;
 }
 
-bool Parser::PeekIsNamedArgument() {
-  Lookahead lookahead(this);
+template<typename B>
+bool BasicParser<B>::PeekIsNamedArgument() {
+  return Memoize(kPeekIsNamedArgument,
+                 &BasicParser::ComputePeekIsNamedArgument);
+}
+
+template<typename B>
+bool BasicParser<B>::ComputePeekIsNamedArgument() {
   Optional(kCOMMA);
   if (!Tokens::IsIdentifier(peek_)) return false;
   Advance();
   return peek_ == kCOLON;
 }
 
-bool Parser::PeekIsMemberStart() {
-  Lookahead lookahead(this);
+template<typename B>
+bool BasicParser<B>::PeekIsMemberStart() {
+  return Memoize(kPeekIsMemberStart, &BasicParser::ComputePeekIsMemberStart);
+}
+
+template<typename B>
+bool BasicParser<B>::ComputePeekIsMemberStart() {
   SkipOptionalType();
   if (!Tokens::IsIdentifier(peek_)) return false;
   Advance();
@@ -1501,23 +1947,39 @@ bool Parser::PeekIsMemberStart() {
   return false;
 }
 
-bool Parser::PeekIsGetter() {
-  Lookahead lookahead(this);
+template<typename B>
+bool BasicParser<B>::PeekIsGetter() {
+  return LookAhead(kPeekIsGetter, &BasicParser::ComputePeekIsGetter);
+}
+
+template<typename B>
+bool BasicParser<B>::ComputePeekIsGetter() {
   if (!Optional(kGET)) return false;
   if (!Tokens::IsIdentifier(peek_)) return false;
   return true;
 }
 
-bool Parser::PeekIsSetter() {
-  Lookahead lookahead(this);
+template<typename B>
+bool BasicParser<B>::PeekIsSetter() {
+  return LookAhead(kPeekIsSetter, &BasicParser::ComputePeekIsSetter);
+}
+
+template<typename B>
+bool BasicParser<B>::ComputePeekIsSetter() {
   if (!Optional(kSET)) return false;
   if (!Tokens::IsIdentifier(peek_)) return false;
   return true;
 }
 
-bool Parser::IsFunctionExpression() {
+template<typename B>
+bool BasicParser<B>::IsFunctionExpression() {
+  return Memoize(kIsFunctionExpression,
+                 &BasicParser::ComputeIsFunctionExpression);
+}
+
+template<typename B>
+bool BasicParser<B>::ComputeIsFunctionExpression() {
   ASSERT(peek_ == kLPAREN);
-  Lookahead lookahead(this);
   int delta = stream_.CurrentIndex();
   if (delta == -1) return false;
   stream_.Skip(delta);
@@ -1527,18 +1989,110 @@ bool Parser::IsFunctionExpression() {
   return (peek_ == kLBRACE || peek_ == kARROW);
 }
 
-bool Parser::IsLabelledStatement() {
+// Only 'const' declarations are statements that start with 'const'.
+template<typename B>
+bool BasicParser<B>::ComputeIsConstDeclaration() {
+  Advance();
+  return PeekIsMemberStart();
+}
+
+template<typename B>
+bool BasicParser<B>::IsLabelledStatement() {
+  return LookAhead(kIsLabelledStatement, &BasicParser::ComputeIsLabelledStatement);
+}
+
+template<typename B>
+bool BasicParser<B>::ComputeIsLabelledStatement() {
   ASSERT(Tokens::IsIdentifier(peek_));
-  Lookahead lookahead(this);
   Advance();
   return (peek_ == kCOLON);
 }
 
-void Parser::Error(const char* format, ...) {
+// Parses with 'parse' and returns true if there was no error. Otherwise
+// the nodes pushed by 'parse' are dropped, the tokens up to the end of the
+// statement, member or declaration that starts at the current token are
+// skipped, and false is returned. Errors jump back here with longjmp, so
+// the parse functions must only have trivially destructible locals. That
+// includes lookahead: it rewinds explicitly, and the recovery rewinds for
+// a walk that reported an error.
+template<typename B>
+bool BasicParser<B>::ParseWithRecovery(void (BasicParser::*parse)()) {
+  int start = stream_.position();
+  int node_count = builder()->node_count();
+  int frame_count = frames_.length();
+  RecoveryPoint point;
+  point.outer = recovery_;
+  recovery_ = &point;
+  if (setjmp(point.buffer) == 0) {
+    (this->*parse)();
+    recovery_ = point.outer;
+    return true;
+  }
+  recovery_ = point.outer;
+  builder()->TruncateNodes(node_count);
+  while (frames_.length() > frame_count) frames_.RemoveLast();
+  SkipToBoundary(start);
+  return false;
+}
+
+// Skips from 'start' past the end of the statement, member or declaration
+// that starts there. Parentheses and braces are jumped over using their
+// bracket offsets. Square brackets are not matched by the scanner, and an
+// unclosed one is a likely error, so they are not skipped. It ends after a
+// ';' or after a block that isn't followed by a token that continues a
+// statement, but not before the error. A '}' that closes the enclosing
+// block ends it too; as the first token it is a stray and is skipped.
+template<typename B>
+void BasicParser<B>::SkipToBoundary(int start) {
+  stream_.RewindTo(start);
+  RefreshPeek();
+  while (peek_ != kEOF) {
+    Token token = peek_;
+    bool is_past_error = stream_.position() >= error_position_;
+    if (token == kRBRACE) {
+      if (stream_.position() == start) Advance();
+      return;
+    }
+    if (token == kLPAREN || token == kLBRACE) {
+      int delta = stream_.CurrentIndex();
+      if (delta > 0) stream_.Skip(delta);
+    }
+    Advance();
+    if (!is_past_error) continue;
+    if (token == kSEMICOLON) return;
+    if (token == kLBRACE) {
+      if (peek_ == kSEMICOLON) {
+        Advance();
+        return;
+      }
+      if (peek_ != kELSE && peek_ != kCATCH && peek_ != kON &&
+          peek_ != kFINALLY && peek_ != kWHILE) {
+        return;
+      }
+    }
+  }
+}
+
+// Continues at the innermost recovery point. The entry points of the
+// parser install one, so there always is one.
+template<typename B>
+void BasicParser<B>::Recover() {
+  ASSERT(recovery_ != NULL);
+  longjmp(recovery_->buffer, 1);
+}
+
+template<typename B>
+void BasicParser<B>::Error(const char* format, ...) {
   va_list args;
   va_start(args, format);
   builder()->ReportError(stream_.CurrentLocation(), format, args);
   va_end(args);
+  error_position_ = stream_.position();
+  Recover();
 }
 
+template class BasicParser<Builder>;
+template class BasicParser<NullBuilder>;
+template class BasicParser<CountingBuilder>;
+
 }  // namespace rart
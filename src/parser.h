@@ -5,21 +5,50 @@
 #ifndef SRC_PARSER_H_
 #define SRC_PARSER_H_
 
+#include <setjmp.h>
+
 #include "src/list.h"
+#include "src/list_builder.h"
+#include "src/parser_statistics.h"
 #include "src/scanner.h"
 #include "src/zone.h"
 
 namespace rart {
 
-class Builder;
-
-class Parser : public StackAllocated {
+// A recursive descent parser that sends the productions it recognizes to
+// a builder of type B. The builder is a compile-time policy, so its
+// events are direct calls that inline if B defines them in a header. The
+// parser is instantiated for Builder, which builds the tree, and for the
+// NullBuilder and CountingBuilder in syntax_builder.h, which only check
+// the syntax. A builder has the events in BUILDER_EVENT_LIST and the
+// parts of Builder's interface that the parser uses for terminals, modes
+// and errors.
+template<typename B>
+class BasicParser : public StackAllocated {
  public:
-  Parser(Builder* builder, List<TokenInfo> tokens);
+  // Parsing starts at the token at 'position'.
+  BasicParser(B* builder, TokenColumns tokens, int position = 0);
+
+#ifdef PARSER_STATISTICS
+  // Adds the statistics to the builder's.
+  ~BasicParser();
 
-  Builder* builder() const { return builder_; }
+  // The events go through a counter on their way to the builder.
+  EventCounter<B>* builder() const { return &events_; }
 
+  const ParserStatistics& statistics() const { return statistics_; }
+#else
+  B* builder() const { return builder_; }
+#endif
+
+  // ParseCompilationUnit and ParseToplevelDeclarations recover from
+  // errors themselves. The other parse functions continue at a recovery
+  // point after an error, so they are called through ParseWithRecovery.
   void ParseCompilationUnit();
+  // Parses the top-level declarations before the token at 'end' and
+  // returns how many there were. The declarations are left on the
+  // builder's stack.
+  int ParseToplevelDeclarations(int end);
   void ParseToplevelDeclaration();
   void ParseImport();
   void ParseExport();
@@ -65,24 +94,16 @@ class Parser : public StackAllocated {
                        bool allow_function = true,
                        bool allow_cascade = true);
   void ParseCascadeRest();
-  void ParsePostfixRest();
   void ParseInvokeRest();
-  void ParseIndexRest();
-  void ParseConditionalRest();
   void ParseIsRest();
   void ParseAsRest();
 
-  void ParseUnary(bool allow_function);
-  void ParsePrimary(bool allow_function);
-  void ParseNew(bool is_const);
   void ParseFunctionExpression();
 
   void ParseIdentifier();
   void ParseQualified();
   void ParseFullyQualified();
 
-  void ParseList(bool typed, bool is_const);
-  void ParseMap(bool typed, bool is_const);
   void ParseInteger();
   void ParseDouble();
   void ParseStringNoInterpolation();
@@ -97,6 +118,16 @@ class Parser : public StackAllocated {
   void SkipOptionalTypeAnnotation();
   void SkipMetadata();
   void SkipFormalParameters();
+  void SkipExpression(bool allow_function);
+  void SkipLibrary();
+  bool SkipToplevelDeclaration();
+  void SkipToBoundary(int start);
+
+  bool ParseWithRecovery(void (BasicParser::*parse)());
+
+  // The position of the current token in the token stream.
+  int position() const { return stream_.position(); }
+  bool is_at_end() const { return peek_ == kEOF; }
 
   Token PeekAfterType();
   Token PeekAfterFormalParameters();
@@ -112,10 +143,126 @@ class Parser : public StackAllocated {
   bool IsLabelledStatement();
 
  private:
-  Builder* const builder_;
+  // The states of a frame in ParseFrames. Most of them are waiting for the
+  // frame of an operand, an element or an argument to be done.
+  enum PrecedenceState {
+    kParseOperand,
+    kParseOperators,
+    kDoUnary,
+    kDoBinary,
+    kDoAssign,
+    kParseElse,
+    kDoConditional,
+    kDoThrow,
+    kDoParenthesized,
+    kDoIndex,
+    kParseArguments,
+    kParseElement,
+    kParseElementRest,
+    kDoList,
+    kParseEntry,
+    kParseEntryValue,
+    kParseEntryRest,
+    kDoMap,
+    kParseCascade,
+    kParseCascadeRest,
+    kDoCascadeAssign,
+    kPopFrame
+  };
+
+  struct RecoveryPoint {
+    jmp_buf buffer;
+    RecoveryPoint* outer;
+  };
+
+  struct PrecedenceFrame {
+    PrecedenceState state;
+    // Operators with a precedence in [precedence, level] are parsed.
+    int precedence;
+    int level;
+    // The operator that is waiting for its operand. For brackets, kNEW or
+    // kCONST if they are the arguments of a constructor call or the
+    // elements of a constant literal.
+    Token token;
+    bool allow_function;
+    bool allow_cascade;
+    // The elements, entries or arguments of a bracket parsed so far.
+    int count;
+    int named_count;
+    // Where a parenthesized expression starts.
+    Location location;
+  };
+
+  // A direct-mapped table of recent answers. Lookahead queries are asked
+  // at nearby positions, so a small table catches the repeated ones.
+  struct MemoEntry {
+    int position;
+    u8 query;
+    u8 answer;
+#ifdef PARSER_STATISTICS
+    // The tokens walked to compute the answer, for counting saved tokens.
+    u16 distance;
+#endif
+  };
+  static const int kMemoSize = 256;
+
+  B* const builder_;
+  const TokenColumns tokens_;
   TokenStream stream_;
   Token peek_;
 
+  ListBuilder<PrecedenceFrame, 16> frames_;
+
+  RecoveryPoint* recovery_ = NULL;
+  int error_position_ = -1;
+
+  MemoEntry memo_[kMemoSize];
+
+#ifdef PARSER_STATISTICS
+  ParserStatistics statistics_;
+  mutable EventCounter<B> events_;
+
+  void RecordStackDepth();
+#endif
+
+  static PrecedenceFrame NewPrecedenceFrame(int precedence,
+                                            bool allow_function,
+                                            bool allow_cascade);
+  static PrecedenceFrame NewBracketFrame(PrecedenceState state, Token token);
+
+  void ParseFrames(PrecedenceFrame frame);
+  // Push 'frame' and replace it with a new frame, which is popped again
+  // when it is done.
+  void PushFrame(PrecedenceFrame* frame, PrecedenceState state, Token token);
+  void PushExpression(PrecedenceFrame* frame, bool allow_cascade);
+
+  // Parse the start of an operand or postfix operator. Brackets push the
+  // frames that parse their contents.
+  void ParsePrimary(PrecedenceFrame* frame);
+  void ParseNew(PrecedenceFrame* frame);
+  void ParseLiteral(PrecedenceFrame* frame, bool is_const);
+  void ParsePostfix(PrecedenceFrame* frame);
+
+  template<typename T>
+  T Memoize(LookaheadQuery query, T (BasicParser::*compute)());
+  MemoEntry* MemoEntryFor(LookaheadQuery query);
+  template<typename T>
+  T LookAhead(LookaheadQuery query, T (BasicParser::*walk)());
+
+  // The walks that answer the lookahead queries. They advance over the
+  // tokens they look at, and LookAhead rewinds.
+  Token ComputePeekAfterType();
+  Token ComputePeekAfterFormalParameters();
+  Token ComputePeekAfterIdentifier();
+  Token ComputePeekNext();
+  bool ComputePeekIsNamedArgument();
+  bool ComputePeekIsMemberStart();
+  bool ComputePeekIsGetter();
+  bool ComputePeekIsSetter();
+  bool ComputeIsFunctionExpression();
+  bool ComputeIsLabelledStatement();
+  bool ComputeIsConstDeclaration();
+
   TokenStream* stream() { return &stream_; }
   void RefreshPeek() { peek_ = stream_.Current(); }
 
@@ -123,11 +270,15 @@ class Parser : public StackAllocated {
   void Expect(Token token);
   bool Optional(Token token);
 
+  // Reports an error to the builder and continues at the innermost
+  // recovery point. Doesn't return.
   void Error(const char* format, ...);
+  void Recover();
 
-  friend class Lookahead;
 };
 
+typedef BasicParser<Builder> Parser;
+
 }  // namespace rart
 
 #endif  // SRC_PARSER_H_
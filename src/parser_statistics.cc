@@ -0,0 +1,69 @@
+// Copyright (c) 2015, the Rart project authors. Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE.md file.
+
+#include <stdio.h>
+
+#include "src/parser_statistics.h"
+#include "src/utils.h"
+
+namespace rart {
+
+static const char* const kQueryNames[] = {
+#define DECLARE(name) #name,
+LOOKAHEAD_QUERY_LIST(DECLARE)
+#undef DECLARE
+};
+
+static const char* const kEventNames[] = {
+#define DECLARE(name, parameters) #name,
+BUILDER_EVENT_LIST(DECLARE)
+#undef DECLARE
+};
+
+void ParserStatistics::Clear() {
+  tokens = 0;
+  max_stack = 0;
+  lookahead_tokens = 0;
+  for (int i = 0; i < kNumberOfLookaheadQueries; i++) {
+    queries[i] = 0;
+    hits[i] = 0;
+    walked[i] = 0;
+    saved[i] = 0;
+  }
+  for (int i = 0; i < kNumberOfBuilderEvents; i++) events[i] = 0;
+}
+
+void ParserStatistics::Add(const ParserStatistics& other) {
+  tokens += other.tokens;
+  max_stack = Utils::Maximum(max_stack, other.max_stack);
+  lookahead_tokens += other.lookahead_tokens;
+  for (int i = 0; i < kNumberOfLookaheadQueries; i++) {
+    queries[i] += other.queries[i];
+    hits[i] += other.hits[i];
+    walked[i] += other.walked[i];
+    saved[i] += other.saved[i];
+  }
+  for (int i = 0; i < kNumberOfBuilderEvents; i++) events[i] += other.events[i];
+}
+
+void ParserStatistics::Print(const char* name) const {
+  fprintf(stderr, "%s: parser statistics\n", name);
+  fprintf(stderr, "  %d tokens advanced, %d of them walked by lookahead\n",
+          tokens, lookahead_tokens);
+  fprintf(stderr, "  %d bytes of stack at most\n", max_stack);
+  fprintf(stderr, "  %-28s %10s %10s %10s %10s\n",
+          "lookahead", "queries", "hits", "walked", "saved");
+  for (int i = 0; i < kNumberOfLookaheadQueries; i++) {
+    if (queries[i] == 0) continue;
+    fprintf(stderr, "  %-28s %10d %10d %10d %10d\n",
+            kQueryNames[i], queries[i], hits[i], walked[i], saved[i]);
+  }
+  fprintf(stderr, "  %-28s %10s\n", "builder event", "count");
+  for (int i = 0; i < kNumberOfBuilderEvents; i++) {
+    if (events[i] == 0) continue;
+    fprintf(stderr, "  %-28s %10d\n", kEventNames[i], events[i]);
+  }
+}
+
+}  // namespace rart
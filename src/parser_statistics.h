@@ -0,0 +1,104 @@
+// Copyright (c) 2015, the Rart project authors. Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE.md file.
+
+#ifndef SRC_PARSER_STATISTICS_H_
+#define SRC_PARSER_STATISTICS_H_
+
+#include <stdarg.h>
+
+#include "src/builder.h"
+
+namespace rart {
+
+// The questions the parser answers by looking ahead and rewinding.
+#define LOOKAHEAD_QUERY_LIST(V)                                              \
+  V(PeekAfterType)                                                           \
+  V(PeekAfterFormalParameters)                                               \
+  V(PeekIsNamedArgument)                                                     \
+  V(PeekIsMemberStart)                                                       \
+  V(IsFunctionExpression)                                                    \
+  V(PeekAfterIdentifier)                                                     \
+  V(PeekNext)                                                                \
+  V(PeekIsGetter)                                                            \
+  V(PeekIsSetter)                                                            \
+  V(IsLabelledStatement)                                                     \
+  V(IsConstDeclaration)                                                      \
+
+enum LookaheadQuery {
+#define DECLARE(name) k##name,
+LOOKAHEAD_QUERY_LIST(DECLARE)
+#undef DECLARE
+  kNumberOfLookaheadQueries
+};
+
+// Where the parser spends its time. The parser only collects these when
+// it is compiled with PARSER_STATISTICS defined. Each parser adds its
+// counts to its builder when it is done, and Builder::BuildUnit prints
+// them for the unit to stderr.
+struct ParserStatistics : public ZoneAllocated {
+  ParserStatistics() { Clear(); }
+
+  void Clear();
+  void Add(const ParserStatistics& other);
+  void Print(const char* name) const;
+
+  // Tokens advanced over, including the ones walked by lookahead.
+  int tokens;
+  // The most native stack the recursive descent used, in bytes.
+  int max_stack;
+  // Tokens walked and rewound by lookahead.
+  int lookahead_tokens;
+  // Per query: how often it was answered by walking the tokens or from
+  // the memo, how often from the memo, how many tokens were walked and
+  // rewound to answer it, and how many the memo hits didn't walk.
+  int queries[kNumberOfLookaheadQueries];
+  int hits[kNumberOfLookaheadQueries];
+  int walked[kNumberOfLookaheadQueries];
+  int saved[kNumberOfLookaheadQueries];
+  int events[kNumberOfBuilderEvents];
+};
+
+// A builder policy that counts the events the parser sends to B before
+// passing them on. With PARSER_STATISTICS defined, the parser sends its
+// events through one of these.
+template<typename B>
+class EventCounter : public StackAllocated {
+ public:
+  EventCounter(B* builder, int* events)
+      : builder_(builder), events_(events) {
+  }
+
+  Zone* zone() const { return builder_->zone(); }
+
+  bool lazy_method_bodies() const { return builder_->lazy_method_bodies(); }
+  bool outline() const { return builder_->outline(); }
+
+  int ComputeCanonicalId(StringSlice name) {
+    return builder_->ComputeCanonicalId(name);
+  }
+
+  int node_count() const { return builder_->node_count(); }
+  void TruncateNodes(int count) { builder_->TruncateNodes(count); }
+
+  void ReportError(Location location, const char* format, va_list args) {
+    builder_->ReportError(location, format, args);
+  }
+
+#define DECLARE(name, parameters)                                            \
+  template<typename... Arguments>                                            \
+  void Do##name(Arguments... arguments) {                                    \
+    events_[k##name##Event]++;                                               \
+    builder_->Do##name(arguments...);                                        \
+  }
+BUILDER_EVENT_LIST(DECLARE)
+#undef DECLARE
+
+ private:
+  B* const builder_;
+  int* const events_;
+};
+
+}  // namespace rart
+
+#endif  // SRC_PARSER_STATISTICS_H_
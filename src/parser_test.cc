@@ -4,10 +4,15 @@
 
 #define TESTING
 
+#include <stdio.h>
+
 #include "src/assert.h"
 #include "src/builder.h"
+#include "src/os.h"
 #include "src/parser.h"
 #include "src/scanner.h"
+#include "src/string_buffer.h"
+#include "src/syntax_builder.h"
 #include "src/test_case.h"
 
 namespace rart {
@@ -16,8 +21,8 @@ TreeNode* ParseNode(Zone* zone, const char* input) {
   Builder builder(zone);
   Scanner scanner(zone, &builder);
   scanner.Scan(input, Location());
-  Parser parser(&builder, scanner.EncodedTokens());
-  parser.ParseExpression();
+  Parser parser(&builder, scanner.EncodedTokenColumns());
+  EXPECT(parser.ParseWithRecovery(&Parser::ParseExpression));
   List<TreeNode*> nodes = builder.Nodes();
   EXPECT_EQ(1, nodes.length());
   return nodes[0];
@@ -29,7 +34,7 @@ int ParseNumber(const char* input) {
 }
 
 const char* ParseString(Zone* zone, const char* input) {
-  return ParseNode(zone, input)->AsLiteralString()->value();
+  return ParseNode(zone, input)->AsLiteralString()->value().ToCString(zone);
 }
 
 TEST_CASE(SimpleLiterals) {
@@ -42,4 +47,306 @@ TEST_CASE(SimpleLiterals) {
   EXPECT_STREQ("bar", ParseString(&zone, "'bar'"));
 }
 
+TEST_CASE(ErrorInEntryPoint) {
+  // An error returns to the recovery point of the entry point.
+  Zone zone;
+  Builder builder(&zone);
+  Scanner scanner(&zone, &builder);
+  scanner.Scan("a + )", Location());
+  Parser parser(&builder, scanner.EncodedTokenColumns());
+  EXPECT(!parser.ParseWithRecovery(&Parser::ParseExpression));
+  EXPECT_EQ(1, builder.Diagnostics().length());
+  EXPECT_EQ(0, builder.Nodes().length());
+}
+
+TEST_CASE(DeepOperatorChains) {
+  // Operator chains are parsed without native recursion, so these don't
+  // run out of stack.
+  const int DEPTH = 200000;
+  Zone zone;
+  StringBuffer buffer(&zone);
+  for (int i = 0; i < DEPTH; i++) buffer.Print("-!");
+  buffer.Print("a");
+  TreeNode* node = ParseNode(&zone, buffer.ToString());
+  for (int i = 0; i < 2 * DEPTH; i++) {
+    UnaryNode* unary = node->AsUnary();
+    EXPECT(unary != NULL);
+    EXPECT_EQ(i % 2 == 0 ? kSUB : kNOT, unary->token());
+    node = unary->expression();
+  }
+  EXPECT(node->IsIdentifier());
+
+  buffer.Clear();
+  for (int i = 0; i < DEPTH; i++) buffer.Print("a = ");
+  buffer.Print("b + c * d");
+  node = ParseNode(&zone, buffer.ToString());
+  for (int i = 0; i < DEPTH; i++) {
+    AssignNode* assign = node->AsAssign();
+    EXPECT(assign != NULL);
+    node = assign->value();
+  }
+  EXPECT_EQ(kADD, node->AsBinary()->token());
+
+  // Binary operators of one precedence associate to the left.
+  buffer.Clear();
+  buffer.Print("a");
+  for (int i = 0; i < DEPTH; i++) buffer.Print(" + a");
+  node = ParseNode(&zone, buffer.ToString());
+  for (int i = 0; i < DEPTH; i++) {
+    BinaryNode* binary = node->AsBinary();
+    EXPECT(binary != NULL);
+    EXPECT_EQ(kADD, binary->token());
+    EXPECT(binary->right()->IsIdentifier());
+    node = binary->left();
+  }
+  EXPECT(node->IsIdentifier());
+
+  // Conditionals associate to the right.
+  buffer.Clear();
+  for (int i = 0; i < DEPTH; i++) buffer.Print("a ? b : ");
+  buffer.Print("c");
+  node = ParseNode(&zone, buffer.ToString());
+  for (int i = 0; i < DEPTH; i++) {
+    ConditionalNode* conditional = node->AsConditional();
+    EXPECT(conditional != NULL);
+    EXPECT(conditional->if_true()->IsIdentifier());
+    node = conditional->if_false();
+  }
+  EXPECT(node->IsIdentifier());
+}
+
+TEST_CASE(DeepNesting) {
+  // Brackets are parsed without native recursion too.
+  const int DEPTH = 100000;
+  Zone zone;
+  StringBuffer buffer(&zone);
+  for (int i = 0; i < DEPTH; i++) buffer.Print("(");
+  buffer.Print("a");
+  for (int i = 0; i < DEPTH; i++) buffer.Print(")");
+  TreeNode* node = ParseNode(&zone, buffer.ToString());
+  for (int i = 0; i < DEPTH; i++) {
+    ParenthesizedNode* parenthesized = node->AsParenthesized();
+    EXPECT(parenthesized != NULL);
+    node = parenthesized->expression();
+  }
+  EXPECT(node->IsIdentifier());
+
+  buffer.Clear();
+  for (int i = 0; i < DEPTH; i++) buffer.Print("[{a: f(b[");
+  buffer.Print("throw c");
+  for (int i = 0; i < DEPTH; i++) buffer.Print("])}]");
+  node = ParseNode(&zone, buffer.ToString());
+  for (int i = 0; i < DEPTH; i++) {
+    LiteralListNode* list = node->AsLiteralList();
+    EXPECT(list != NULL);
+    EXPECT_EQ(1, list->elements().length());
+    LiteralMapNode* map = list->elements()[0]->AsLiteralMap();
+    EXPECT(map != NULL);
+    EXPECT_EQ(1, map->values().length());
+    InvokeNode* invoke = map->values()[0]->AsInvoke();
+    EXPECT(invoke != NULL);
+    EXPECT_EQ(1, invoke->arguments().length());
+    IndexNode* index = invoke->arguments()[0]->AsIndex();
+    EXPECT(index != NULL);
+    node = index->key();
+  }
+  EXPECT(node->IsThrow());
+
+  buffer.Clear();
+  for (int i = 0; i < DEPTH; i++) buffer.Print("const A(x: new A(0, ");
+  buffer.Print("a..b(c)..d = e");
+  for (int i = 0; i < DEPTH; i++) buffer.Print("))");
+  node = ParseNode(&zone, buffer.ToString());
+  for (int i = 0; i < 2 * DEPTH; i++) {
+    NewNode* new_node = node->AsNew();
+    EXPECT(new_node != NULL);
+    EXPECT_EQ(i % 2 == 0, new_node->is_const());
+    List<ExpressionNode*> arguments = new_node->invoke()->arguments();
+    EXPECT_EQ(i % 2 == 0 ? 1 : 2, arguments.length());
+    EXPECT_EQ(i % 2 == 0 ? 1 : 0,
+              new_node->invoke()->named_arguments().length());
+    node = arguments[arguments.length() - 1];
+  }
+  EXPECT(node->IsCascade());
+
+  // A whole unit with a deeply nested literal.
+  buffer.Clear();
+  buffer.Print("main() { var x = ");
+  for (int i = 0; i < DEPTH; i++) buffer.Print("[");
+  buffer.Print("1");
+  for (int i = 0; i < DEPTH; i++) buffer.Print("]");
+  buffer.Print("; }\n");
+  Builder builder(&zone);
+  Scanner scanner(&zone, &builder);
+  scanner.Scan(buffer.ToString(), Location());
+  Parser parser(&builder, scanner.EncodedTokenColumns());
+  parser.ParseCompilationUnit();
+  EXPECT(!builder.has_errors());
+  EXPECT_EQ(1, builder.Nodes().length());
+}
+
+TEST_CASE(SyntaxBuilders) {
+  Zone zone;
+  Builder builder(&zone);
+  Scanner scanner(&zone, &builder);
+  scanner.Scan("class A { foo(a, b) { return a + b * 2; } }\n"
+               "main() { var x = #a.b; }\n",
+               Location());
+  CountingBuilder counter(&builder);
+  BasicParser<CountingBuilder> parser(&counter,
+                                      scanner.EncodedTokenColumns());
+  parser.ParseCompilationUnit();
+  EXPECT_EQ(1, counter.count(kCompilationUnitEvent));
+  EXPECT_EQ(1, counter.count(kClassEvent));
+  EXPECT_EQ(2, counter.count(kMethodEvent));
+  EXPECT_EQ(2, counter.count(kBinaryEvent));
+  EXPECT_EQ(3, counter.count(kSymbolPartEvent));
+  EXPECT_EQ(0, counter.count(kIfEvent));
+  // Nothing is built, and the syntax is fine.
+  EXPECT_EQ(0, builder.Nodes().length());
+  EXPECT(!builder.has_errors());
+
+  // Errors are reported to the builder that scanned the tokens.
+  Builder other(&zone);
+  Scanner other_scanner(&zone, &other);
+  other_scanner.Scan("main() { a b c; d(; }\n", Location());
+  NullBuilder checker(&other);
+  BasicParser<NullBuilder> checking_parser(
+      &checker, other_scanner.EncodedTokenColumns());
+  checking_parser.ParseCompilationUnit();
+  EXPECT_EQ(2, other.Diagnostics().length());
+}
+
+#ifdef PARSER_STATISTICS
+TEST_CASE(LookaheadMemo) {
+  Zone zone;
+  const char* input =
+      "class A {\n"
+      "  Map<String, List<int>> x;\n"
+      "  foo(a, {b: 2}) {\n"
+      "    List<int> y = [1, 2];\n"
+      "    var f = (a, b) => a + b;\n"
+      "    return bar(a, b: (c) { return c; });\n"
+      "  }\n"
+      "}\n";
+  Builder builder(&zone);
+  Scanner scanner(&zone, &builder);
+  scanner.Scan(input, Location());
+  Parser parser(&builder, scanner.EncodedTokenColumns());
+  parser.ParseCompilationUnit();
+  EXPECT_EQ(1, builder.Nodes().length());
+  const ParserStatistics& statistics = parser.statistics();
+  int queries = 0;
+  int hits = 0;
+  int saved = 0;
+  for (int i = 0; i < kNumberOfLookaheadQueries; i++) {
+    queries += statistics.queries[i];
+    hits += statistics.hits[i];
+    saved += statistics.saved[i];
+  }
+  EXPECT_GT(queries, hits);
+  EXPECT_GT(hits, 0);
+  EXPECT_GT(saved, 0);
+  printf("LookaheadMemo: %d queries, %d hits, "
+         "%d tokens walked, %d tokens saved\n",
+         queries, hits, statistics.lookahead_tokens, saved);
+}
+
+TEST_CASE(ParserStatistics) {
+  Zone zone;
+  const char* input =
+      "class A {\n"
+      "  List<int> x;\n"
+      "  foo(a, {b: 2}) {\n"
+      "    const y = 1;\n"
+      "    return bar(a, b: (c) => c + y);\n"
+      "  }\n"
+      "}\n";
+  Builder builder(&zone);
+  Location location =
+      builder.source()->LoadFromBuffer("<statistics>", input, strlen(input));
+  builder.BuildUnit(location);
+  ParserStatistics* statistics = builder.statistics();
+  EXPECT_GT(statistics->tokens, 40);
+  EXPECT_GT(statistics->max_stack, 0);
+  EXPECT_GT(statistics->queries[kPeekAfterType], 0);
+  EXPECT_GT(statistics->walked[kIsFunctionExpression], 0);
+  EXPECT_GT(statistics->queries[kIsConstDeclaration], 0);
+  EXPECT_EQ(1, statistics->events[kCompilationUnitEvent]);
+  EXPECT_EQ(1, statistics->events[kClassEvent]);
+  EXPECT_EQ(1, statistics->events[kMethodEvent]);
+  EXPECT_EQ(1, statistics->events[kFunctionExpressionEvent]);
+}
+#endif
+
+TEST_CASE(ParserSpeed) {
+  Zone zone;
+  const int REPEAT = 5;
+  StringBuffer buffer(&zone);
+  for (int i = 0; i < 10000; i++) {
+    buffer.Print(
+        "class C%d extends Base implements I {\n"
+        "  int field%d = 0;\n"
+        "  final List<String> names = <String>['a', 'b'];\n"
+        "  int add%d(int a, {int b: 2}) {\n"
+        "    var sum = 0;\n"
+        "    for (int i = 0; i < a; i++) {\n"
+        "      if (i % 2 == 0 && b > i) sum += foo(i, b: [1, 2, 3]);\n"
+        "    }\n"
+        "    return sum * %d + names.length;\n"
+        "  }\n"
+        "}\n"
+        "\n",
+        i, i, i, i);
+  }
+  const char* input = buffer.ToString();
+  size_t length = strlen(input);
+  // Full parse, lazy method bodies, outline and syntax only.
+  const int MODES = 4;
+  i64 elapsed[MODES] = { 0, 0, 0, 0 };
+  for (int i = 0; i < REPEAT; i++) {
+    for (int mode = 0; mode < MODES; mode++) {
+      Zone parse_zone;
+      Builder builder(&parse_zone);
+      builder.set_lazy_method_bodies(mode == 1);
+      builder.set_outline(mode == 2);
+      Scanner scanner(&parse_zone, &builder);
+      scanner.Scan(input, Location());
+      if (mode == 3) {
+        NullBuilder checker(&builder);
+        BasicParser<NullBuilder> parser(&checker,
+                                        scanner.EncodedTokenColumns());
+        i64 start = OS::CurrentTime();
+        parser.ParseCompilationUnit();
+        elapsed[mode] += OS::CurrentTime() - start;
+        EXPECT(!builder.has_errors());
+        continue;
+      }
+      Parser parser(&builder, scanner.EncodedTokenColumns());
+      i64 start = OS::CurrentTime();
+      parser.ParseCompilationUnit();
+      elapsed[mode] += OS::CurrentTime() - start;
+      EXPECT_EQ(1, builder.Nodes().length());
+#ifdef PARSER_STATISTICS
+      if (i == 0 && mode == 0) {
+        int saved = 0;
+        for (int j = 0; j < kNumberOfLookaheadQueries; j++) {
+          saved += parser.statistics().saved[j];
+        }
+        printf("ParserSpeed lookahead: %d tokens walked, %d tokens saved\n",
+               parser.statistics().lookahead_tokens, saved);
+      }
+#endif
+    }
+  }
+  double speed[MODES];
+  for (int mode = 0; mode < MODES; mode++) {
+    if (elapsed[mode] <= 0) elapsed[mode] = 1;
+    speed[mode] = static_cast<double>(length) * REPEAT / elapsed[mode];
+  }
+  printf("ParserSpeed: %.1f MB/s, lazy method bodies %.1f MB/s, "
+         "outline %.1f MB/s, syntax only %.1f MB/s\n",
+         speed[0], speed[1], speed[2], speed[3]);
+}
+
 }  // namespace rart
@@ -48,7 +48,9 @@ void PrettyPrinter::DoPartOf(PartOfNode* node) {
 
 void PrettyPrinter::DoClass(ClassNode* node) {
   if (node->is_abstract()) buffer()->Print("abstract ");
-  buffer()->Print("class %s ", node->name()->value());
+  buffer()->Print("class ");
+  buffer()->Append(node->name()->value());
+  buffer()->Print(" ");
   if (node->has_super()) {
     buffer()->Print("extends ");
     node->super()->Accept(this);
@@ -77,7 +79,9 @@ void PrettyPrinter::DoClass(ClassNode* node) {
 }
 
 void PrettyPrinter::DoTypedef(TypedefNode* node) {
-  buffer()->Print("typedef %s(", node->name()->value());
+  buffer()->Print("typedef ");
+  buffer()->Append(node->name()->value());
+  buffer()->Print("(");
   List<TreeNode*> parameters = node->parameters();
   for (int i = 0; i < parameters.length(); i++) {
     if (i != 0) buffer()->Print(",");
@@ -188,7 +192,7 @@ void PrettyPrinter::DoVariableDeclarationStatement(
   for (int i = 0; i < declarations.length(); i++) {
     if (i != 0) buffer()->Print(",");
     VariableDeclarationNode* variable = declarations[i];
-    buffer()->Print("%s", variable->name()->value());
+    buffer()->Append(variable->name()->value());
     if (variable->has_initializer()) {
       buffer()->Print("=");
       variable->value()->Accept(this);
@@ -260,13 +264,19 @@ void PrettyPrinter::DoDoWhile(DoWhileNode* node) {
 
 void PrettyPrinter::DoBreak(BreakNode* node) {
   buffer()->Print("break");
-  if (node->has_label()) buffer()->Print(" %s", node->label()->value());
+  if (node->has_label()) {
+    buffer()->Print(" ");
+    buffer()->Append(node->label()->value());
+  }
   buffer()->Print(";");
 }
 
 void PrettyPrinter::DoContinue(ContinueNode* node) {
   buffer()->Print("continue");
-  if (node->has_label()) buffer()->Print(" %s", node->label()->value());
+  if (node->has_label()) {
+    buffer()->Print(" ");
+    buffer()->Append(node->label()->value());
+  }
   buffer()->Print(";");
 }
 
@@ -391,7 +401,8 @@ void PrettyPrinter::DoBinary(BinaryNode* node) {
 
 void PrettyPrinter::DoDot(DotNode* node) {
   node->object()->Accept(this);
-  buffer()->Print(".%s", node->name()->value());
+  buffer()->Print(".");
+  buffer()->Append(node->name()->value());
 }
 
 void PrettyPrinter::DoCascadeReceiver(CascadeReceiverNode* node) {
@@ -461,7 +472,7 @@ void PrettyPrinter::DoNew(NewNode* node) {
 }
 
 void PrettyPrinter::DoIdentifier(IdentifierNode* node) {
-  buffer()->Print("%s", node->value());
+  buffer()->Append(node->value());
 }
 
 void PrettyPrinter::DoThis(ThisNode* node) {
@@ -479,12 +490,14 @@ void PrettyPrinter::DoNull(NullNode* node) {
 void PrettyPrinter::DoStringInterpolation(StringInterpolationNode* node) {
   List<LiteralStringNode*> strings = node->strings();
   List<ExpressionNode*> expressions = node->expressions();
-  buffer()->Print("'%s", strings[0]->value());
+  buffer()->Print("'");
+  buffer()->Append(strings[0]->value());
   int length = expressions.length();
   for (int i = 0; i < length; i++) {
     buffer()->Print("${");
     expressions[i]->Accept(this);
-    buffer()->Print("}%s", strings[i + 1]->value());
+    buffer()->Print("}");
+    buffer()->Append(strings[i + 1]->value());
   }
   buffer()->Print("'");
 }
@@ -512,7 +525,9 @@ void PrettyPrinter::DoLiteralDouble(LiteralDoubleNode* node) {
 }
 
 void PrettyPrinter::DoLiteralString(LiteralStringNode* node) {
-  buffer()->Print("'%s'", node->value());
+  buffer()->Print("'");
+  buffer()->Append(node->value());
+  buffer()->Print("'");
 }
 
 void PrettyPrinter::DoLiteralBoolean(LiteralBooleanNode* node) {
@@ -2,70 +2,699 @@
 // for details. All rights reserved. Use of this source code is governed by a
 // BSD-style license that can be found in the LICENSE.md file.
 
-#include <errno.h>
-#include <cstdlib>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "src/assert.h"
+#include "src/number_conversion.h"
 #include "src/scanner.h"
+#include "src/simd.h"
+#include "src/tree.h"
+#include "src/utf8.h"
 
 namespace rart {
 
-inline bool IsNewline(int c) {
-  return (c == 10) || (c == 13);
+// Character classes. Each byte maps to a bitmask of the classes it
+// belongs to, so classifying a character is one load and one test.
+enum CharacterClass {
+  kWhitespaceClass        = 1 << 0,
+  kNewlineClass           = 1 << 1,
+  kIdentifierStartClass   = 1 << 2,
+  kIdentifierPartClass    = 1 << 3,
+  // Identifier parts except '$', for identifiers in string interpolation.
+  kInterpolationPartClass = 1 << 4,
+  kDecimalDigitClass      = 1 << 5,
+  kHexDigitClass          = 1 << 6,
+  kStringStartClass       = 1 << 7,
+};
+
+static constexpr bool IsInRange(int c, int from, int to) {
+  return (from <= c) && (c <= to);
 }
 
-inline bool IsWhitespace(int c) {
-  return (c == ' ') || IsNewline(c) || (c == '\t');
+static constexpr int ComputeCharacterClasses(int c) {
+  return ((c == ' ' || c == '\t' || c == '\n' || c == '\r')
+              ? kWhitespaceClass : 0)
+      | ((c == '\n' || c == '\r') ? kNewlineClass : 0)
+      | ((IsInRange(c, 'A', 'Z') || IsInRange(c, 'a', 'z') ||
+          c == '_' || c == '$')
+              ? kIdentifierStartClass | kIdentifierPartClass : 0)
+      | ((IsInRange(c, 'A', 'Z') || IsInRange(c, 'a', 'z') ||
+          IsInRange(c, '0', '9') || c == '_')
+              ? kInterpolationPartClass : 0)
+      | (IsInRange(c, '0', '9')
+              ? kDecimalDigitClass | kIdentifierPartClass : 0)
+      | ((IsInRange(c, '0', '9') || IsInRange(c, 'A', 'F') ||
+          IsInRange(c, 'a', 'f'))
+              ? kHexDigitClass : 0)
+      | ((c == '\'' || c == '"') ? kStringStartClass : 0);
+}
+
+static const u8 kCharacterClasses[256] = {
+#define S(n) ComputeCharacterClasses(n),
+  REPEAT_256(S, 0)
+#undef S
+};
+
+inline bool HasClass(int c, int mask) {
+  return (kCharacterClasses[static_cast<u8>(c)] & mask) != 0;
+}
+
+inline bool IsNewline(int c) {
+  return HasClass(c, kNewlineClass);
 }
 
-inline bool IsLetter(int c) {
-  return (('A' <= c) && (c <= 'Z')) || (('a' <= c) && (c <= 'z'));
+inline bool IsWhitespace(int c) {
+  return HasClass(c, kWhitespaceClass);
 }
 
 inline bool IsDecimalDigit(int c) {
-  return ('0' <= c) && (c <= '9');
+  return HasClass(c, kDecimalDigitClass);
 }
 
 inline bool IsHexDigit(int c) {
-  return IsDecimalDigit(c) ||
-      (('A' <= c) && (c <= 'F')) ||
-      (('a' <= c) && (c <= 'f'));
+  return HasClass(c, kHexDigitClass);
+}
+
+inline int HexDigitValue(int c) {
+  ASSERT(IsHexDigit(c));
+  return (c <= '9') ? c - '0' : (c | 0x20) - 'a' + 10;
 }
 
 inline bool IsIdentifierStart(int c) {
-  return IsLetter(c) || (c == '_') || (c == '$');
+  return HasClass(c, kIdentifierStartClass);
 }
 
 inline bool IsIdentifierPart(int c) {
-  return IsIdentifierStart(c) || IsDecimalDigit(c);
+  return HasClass(c, kIdentifierPartClass);
+}
+
+inline bool IsInterpolationPart(int c) {
+  return HasClass(c, kInterpolationPartClass);
 }
 
 inline bool IsStringStart(int c) {
-  return (c == '\'') || (c == '"');
+  return HasClass(c, kStringStartClass);
 }
 
-void Punctuation::Populate(Zone* zone, Token token, const char* string) {
-  if (*string == '\0') {
-    ASSERT(terminal_ == kEOF);
-    terminal_ = token;
-  } else {
-    Punctuation* next = Child(zone, *string);
-    next->Populate(zone, token, string + 1);
-  }
+// The punctuation scanner is a DFA whose states are the punctuation
+// tokens. Every prefix of a punctuation token is itself a token, so
+// the scanner can follow transitions for as long as there are any and
+// then emit the token named by the current state. The tables are built
+// at compile time from PUNCTUATION_LIST.
+
+// Characters that can follow the first character of a punctuation token.
+// Each of them gets a column in the transition table; column 0 is used
+// for all other characters and never has a transition.
+static constexpr char kPunctuationContinuations[] = "=>+-]</.|&";
+static const int kPunctuationColumns = sizeof(kPunctuationContinuations);
+
+static constexpr int PunctuationColumn(int c, int column = 1) {
+  return (column == kPunctuationColumns)
+      ? 0
+      : (kPunctuationContinuations[column - 1] == c)
+          ? column
+          : PunctuationColumn(c, column + 1);
 }
 
+static constexpr const char* PunctuationSyntax(Token token) {
+  return
+#define T(n, s, p) (token == n) ? s :
+PUNCTUATION_LIST(T)
+#undef T
+      "";
+}
+
+// Is 'syntax' the string 'prefix' followed by the character c?
+static constexpr bool IsExtension(const char* syntax,
+                                  const char* prefix,
+                                  int c) {
+  return (*prefix == '\0')
+      ? (syntax[0] == c && syntax[1] == '\0')
+      : (*syntax == *prefix && IsExtension(syntax + 1, prefix + 1, c));
+}
+
+// Returns the single character punctuation token for c, or kEOF.
+static constexpr Token PunctuationStart(int c) {
+  return
+#define T(n, s, p) IsExtension(s, "", c) ? n :
+PUNCTUATION_LIST(T)
+#undef T
+      kEOF;
+}
+
+static constexpr Token PunctuationNext(Token state, int column) {
+  return (column == 0) ? kEOF :
+#define T(n, s, p) \
+      IsExtension(s, PunctuationSyntax(state), \
+                  kPunctuationContinuations[column - 1]) ? n :
+PUNCTUATION_LIST(T)
+#undef T
+      kEOF;
+}
+
+// Opening brackets push a begin marker, and closing brackets pop the
+// marker of the matching opening bracket.
+static constexpr Token PunctuationPush(Token token) {
+  return (token == kLPAREN || token == kLT || token == kLBRACE) ? token : kEOF;
+}
+
+static constexpr Token PunctuationPop(Token token) {
+  return (token == kRPAREN) ? kLPAREN
+      : (token == kGT) ? kLT
+      : (token == kRBRACE) ? kLBRACE
+      : kEOF;
+}
+
+struct PunctuationState {
+  u8 next[kPunctuationColumns];
+  u8 push;
+  u8 pop;
+};
+
+static const u8 kPunctuationStart[256] = {
+#define S(n) PunctuationStart(n),
+  REPEAT_256(S, 0)
+#undef S
+};
+
+static const u8 kPunctuationColumn[256] = {
+#define S(n) PunctuationColumn(n),
+  REPEAT_256(S, 0)
+#undef S
+};
+
+static_assert(kPunctuationColumns == 11, "Update the table below");
+static const PunctuationState kPunctuationStates[] = {
+#define T(n, s, p)                                                      \
+  { { PunctuationNext(n, 0), PunctuationNext(n, 1), PunctuationNext(n, 2), \
+      PunctuationNext(n, 3), PunctuationNext(n, 4), PunctuationNext(n, 5), \
+      PunctuationNext(n, 6), PunctuationNext(n, 7), PunctuationNext(n, 8), \
+      PunctuationNext(n, 9), PunctuationNext(n, 10) },                    \
+    PunctuationPush(n), PunctuationPop(n) },
+PUNCTUATION_LIST(T)
+#undef T
+};
+
+// Running the DFA over the syntax of each token must end in the token.
+static constexpr Token PunctuationRun(Token state, const char* rest) {
+  return (*rest == '\0' || state == kEOF)
+      ? state
+      : PunctuationRun(PunctuationNext(state, PunctuationColumn(*rest)),
+                       rest + 1);
+}
+
+#define T(n, s, p)                                                      \
+  static_assert(PunctuationRun(PunctuationStart(s[0]), s + 1) == n,     \
+                "Punctuation not recognized: " s);
+PUNCTUATION_LIST(T)
+#undef T
+
 List<TokenInfo> Scanner::EncodedTokens() {
   input_ = NULL;
   return tokens_.ToList();
 }
 
+TokenColumns Scanner::EncodedTokenColumns() {
+  return TokenColumns::Split(tokens_.zone(), EncodedTokens());
+}
+
+TokenColumns TokenColumns::Split(Zone* zone, List<TokenInfo> encoded) {
+  int length = encoded.length();
+  List<u8> tokens = List<u8>::New(zone, length);
+  List<int> indexes = List<int>::New(zone, length);
+  List<Location> locations = List<Location>::New(zone, length);
+  for (int i = 0; i < length; i++) {
+    TokenInfo info = encoded[i];
+    tokens[i] = info.token();
+    indexes[i] = info.index();
+    locations[i] = info.location();
+  }
+  return TokenColumns(tokens, indexes, locations);
+}
+
 void Scanner::Scan(const char* input, Location start_location) {
   tokens_.Clear();
   ASSERT(input_ == NULL);
   input_ = input;
   index_ = 0;
+  final_ = true;
   start_location_ = start_location;
+  SkipPrologue();
+  while (ScanToken()) {
+    // Keep going.
+  }
+  AddToken(kEOF);
+}
+
+void Scanner::Begin(Location start_location) {
+  tokens_.Clear();
+  ASSERT(input_ == NULL);
+  ASSERT(buffer_ == NULL);
+  capacity_ = kInitialBufferSize;
+  buffer_ = static_cast<char*>(malloc(capacity_));
+  buffer_[0] = '\0';
+  available_ = 0;
+  input_ = buffer_;
+  index_ = 0;
+  final_ = false;
+  skip_prologue_ = true;
+  start_location_ = start_location;
+}
+
+void Scanner::Feed(const char* chunk, int length) {
+  ASSERT(buffer_ != NULL && !final_);
+  // Drop the input that has been scanned. Token locations are relative
+  // to start_location_, so move it along.
+  if (index_ > 0) {
+    available_ -= index_;
+    memmove(buffer_, buffer_ + index_, available_);
+    start_location_ = start_location_ + index_;
+    index_ = 0;
+  }
+  if (available_ + length + 1 > capacity_) {
+    capacity_ = Utils::Maximum(2 * capacity_, available_ + length + 1);
+    buffer_ = static_cast<char*>(realloc(buffer_, capacity_));
+  }
+  memcpy(buffer_ + available_, chunk, length);
+  available_ += length;
+  buffer_[available_] = '\0';
+  input_ = buffer_;
+  ScanAvailable();
+}
+
+void Scanner::End() {
+  ASSERT(buffer_ != NULL && !final_);
+  final_ = true;
+  ScanAvailable();
+  AddToken(kEOF);
+  free(buffer_);
+  buffer_ = NULL;
+  input_ = NULL;
+}
+
+void Scanner::Rescan(List<TokenInfo> previous, const char* input,
+                     Location start_location, int offset, int deleted,
+                     int inserted) {
+  tokens_.Clear();
+  ASSERT(input_ == NULL);
+  input_ = input;
+  index_ = 0;
+  final_ = true;
+  start_location_ = start_location;
+  int restart = FindRestart(previous, offset);
+  if (restart < 0) {
+    restart = 0;
+    SkipPrologue();
+  } else {
+    for (int i = 0; i < restart; i++) tokens_.Add(previous[i]);
+    // Rebuild the begin marker stack as it was at the restart token.
+    for (int i = 0; i < restart; ) i = ReplayToken(previous, i, restart, 0);
+    index_ = OffsetOf(previous[restart]);
+  }
+  // Past the edit the input is the same as before, so once a token starts
+  // where a token of the previous scan started, the rest of the tokens
+  // are the same too. The EOF token is not a token start to look for; the
+  // previous scan may have stopped early because of an error.
+  int delta = inserted - deleted;
+  int last = previous.length() - 1;
+  int candidate = restart;
+  while (true) {
+    if (index_ >= offset + inserted) {
+      int old_index = index_ - delta;
+      while (candidate < last && OffsetOf(previous[candidate]) < old_index) {
+        candidate++;
+      }
+      if (candidate < last &&
+          OffsetOf(previous[candidate]) == old_index &&
+          !previous[candidate].is_continuation()) {
+        int shift = tokens_.length() - candidate;
+        for (int i = candidate; i < previous.length(); i++) {
+          TokenInfo info = previous[i];
+          tokens_.Add(info.WithLocation(info.location() + delta));
+        }
+        // Only the brackets that are still open at this point can be
+        // matched differently than before, so stop replaying when they
+        // have all been closed.
+        int outer = begin_marker_stack_.length();
+        for (int i = candidate; i < previous.length() && outer > 0; ) {
+          i = ReplayToken(previous, i, previous.length(), shift);
+          outer = Utils::Minimum(outer, begin_marker_stack_.length());
+        }
+        return;
+      }
+    }
+    if (!ScanToken()) break;
+  }
+  AddToken(kEOF);
+}
+
+int Scanner::FindRestart(List<TokenInfo> previous, int offset) const {
+  // Tokens before the restart token must not have looked at the edited
+  // input, so the restart token has to start far enough before the edit.
+  int low = 0;
+  int high = previous.length() - 1;
+  while (low < high) {
+    int middle = (low + high) / 2;
+    if (OffsetOf(previous[middle]) + kMaxLookahead <= offset) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  int restart = low - 1;
+  while (restart >= 0 && previous[restart].is_continuation()) restart--;
+  return restart;
+}
+
+int Scanner::ReplayToken(List<TokenInfo> previous, int index, int end,
+                         int shift) {
+  TokenInfo info = previous[index];
+  Token token = info.token();
+  int position = index + shift;
+  // The bracket offsets of continuations only refer to other tokens in
+  // the same string.
+  if (info.is_continuation() || token < kCOMMA) {
+    return index + 1;
+  }
+  if (token == kGT_START) {
+    // The second half of '>>' is a continuation, but it closes an angle
+    // bracket too.
+    PopTokenBeginMarker(kLT, position);
+    PopTokenBeginMarker(kLT, position + 1);
+    return index + 2;
+  }
+  if (token > kGTE) return index + 1;
+  const PunctuationState& state = kPunctuationStates[token - kCOMMA];
+  if (state.pop != kEOF) {
+    PopTokenBeginMarker(static_cast<Token>(state.pop), position);
+  } else if (state.push != kEOF) {
+    int match = index + info.index();
+    if (info.index() >= 0 && match < end) {
+      // Nothing between a bracket and its match reaches below the bracket
+      // on the stack, so the pair can be skipped. If the match is the
+      // first half of '>>', the second half still has to be replayed.
+      if (previous[match].token() != kGT_START) return match + 1;
+      PopTokenBeginMarker(kLT, match + 1 + shift);
+      return match + 2;
+    }
+    // The bracket is still open at the end. Its offset is set again when
+    // it is closed.
+    if (info.index() >= 0) tokens_.Set(position, info.WithIndex(-1));
+    PushTokenBeginMarker(static_cast<Token>(state.push), position);
+  }
+  return index + 1;
+}
+
+// A slice of the input for ScanParallel. The thread that scans the slice
+// keeps its builder and scanner alive until the slice is adopted. The
+// zone is adopted by the stitching scanner's zone, so the terminals of
+// the slice outlive the thread.
+struct Scanner::Slice {
+  const char* input;
+  Location start_location;
+  int begin;
+  int end;
+
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t condition;
+  bool scanned;
+  bool adopted;
+
+  // Set when the slice has been scanned. The terminal ids of the tokens
+  // refer to the slice's own registries.
+  Zone* zone;
+  List<TokenInfo> tokens;
+  List<StringSlice> identifiers;
+  List<u32> identifier_hashes;
+  List<TreeNode*> registry;
+  List<LiteralStringNode*> strings;
+  int stop;
+};
+
+void Scanner::ScanParallel(const char* input, Location start_location,
+                           int threads) {
+  // Cut the input into slices that start at line starts.
+  int length = strlen(input);
+  Slice* slices = static_cast<Slice*>(
+      builder()->zone()->Allocate(threads * sizeof(Slice)));
+  int count = 0;
+  int begin = 0;
+  while (begin < length && count < threads) {
+    int end = length;
+    if (count + 1 < threads) {
+      int split = static_cast<int>(static_cast<i64>(length) * (count + 1) /
+                                   threads);
+      const char* newline = strchr(input + Utils::Maximum(begin, split), '\n');
+      if (newline != NULL) end = newline + 1 - input;
+    }
+    Slice* slice = &slices[count++];
+    slice->input = input;
+    slice->start_location = start_location;
+    slice->begin = begin;
+    slice->end = end;
+    begin = end;
+  }
+  if (count <= 1) {
+    Scan(input, start_location);
+    return;
+  }
+
+  // The first slice is scanned on this thread.
+  for (int i = 1; i < count; i++) {
+    Slice* slice = &slices[i];
+    slice->scanned = false;
+    slice->adopted = false;
+    pthread_mutex_init(&slice->mutex, NULL);
+    pthread_cond_init(&slice->condition, NULL);
+    pthread_create(&slice->thread, NULL, &RunSlice, slice);
+  }
+
+  tokens_.Clear();
+  ASSERT(input_ == NULL);
+  input_ = input;
+  index_ = 0;
+  final_ = true;
+  start_location_ = start_location;
+  SkipPrologue();
+  bool more = true;
+  for (int i = 1; i < count; i++) {
+    Slice* slice = &slices[i];
+    while (more && index_ < slice->begin) more = ScanToken();
+    pthread_mutex_lock(&slice->mutex);
+    while (!slice->scanned) pthread_cond_wait(&slice->condition, &slice->mutex);
+    pthread_mutex_unlock(&slice->mutex);
+    // If the slice did not start where a token could start, the guessed
+    // tokens at its start are wrong. Scan on until a token starts where
+    // the slice also has a token start; from there on the tokens agree.
+    List<TokenInfo> guessed = slice->tokens;
+    int candidate = 0;
+    while (more && index_ < slice->stop) {
+      while (candidate < guessed.length() &&
+             OffsetOf(guessed[candidate]) < index_) {
+        candidate++;
+      }
+      if (candidate < guessed.length() &&
+          OffsetOf(guessed[candidate]) == index_ &&
+          !guessed[candidate].is_continuation()) {
+        AdoptSlice(slice, candidate);
+        index_ = slice->stop;
+        break;
+      }
+      more = ScanToken();
+    }
+  }
+  while (more) more = ScanToken();
+  AddToken(kEOF);
+
+  for (int i = 1; i < count; i++) {
+    Slice* slice = &slices[i];
+    pthread_mutex_lock(&slice->mutex);
+    slice->adopted = true;
+    pthread_cond_signal(&slice->condition);
+    pthread_mutex_unlock(&slice->mutex);
+    pthread_join(slice->thread, NULL);
+    pthread_cond_destroy(&slice->condition);
+    pthread_mutex_destroy(&slice->mutex);
+  }
+}
+
+void* Scanner::RunSlice(void* argument) {
+  Slice* slice = static_cast<Slice*>(argument);
+  Zone zone;
+  Builder builder(&zone);
+  Scanner scanner(&zone, &builder);
+  int stop = scanner.ScanSlice(slice->input, slice->start_location,
+                               slice->begin, slice->end);
+  // Hash the identifiers here, so stitching doesn't have to.
+  List<StringSlice> identifiers = builder.Identifiers();
+  List<u32> hashes = List<u32>::New(&zone, identifiers.length());
+  for (int i = 0; i < identifiers.length(); i++) {
+    hashes[i] = Utils::StringHash(identifiers[i].data(),
+                                  identifiers[i].length());
+  }
+  pthread_mutex_lock(&slice->mutex);
+  slice->zone = &zone;
+  slice->tokens = scanner.EncodedTokens();
+  slice->identifiers = identifiers;
+  slice->identifier_hashes = hashes;
+  slice->registry = builder.Registry();
+  slice->strings = builder.Strings();
+  slice->stop = stop;
+  slice->scanned = true;
+  pthread_cond_signal(&slice->condition);
+  while (!slice->adopted) pthread_cond_wait(&slice->condition, &slice->mutex);
+  pthread_mutex_unlock(&slice->mutex);
+  return NULL;
+}
+
+int Scanner::ScanSlice(const char* input, Location start_location,
+                       int begin, int end) {
+  ASSERT(input_ == NULL);
+  input_ = input;
+  index_ = begin;
+  final_ = true;
+  speculative_ = true;
+  start_location_ = start_location;
+  while (index_ < end) {
+    int index = index_;
+    int token_count = tokens_.length();
+    bool more = ScanToken();
+    if (!more || suspended_) {
+      // Leave the last token to be scanned again, so errors are reported
+      // and the EOF token is added by the scan that adopts the slice. An
+      // error inside a string interpolation does not always end the scan,
+      // so the scanner is checked for suspension too.
+      while (tokens_.length() > token_count) tokens_.RemoveLast();
+      return index;
+    }
+  }
+  return index_;
+}
+
+int Scanner::MergeIdentifier(Slice* slice, int id) {
+  // The slice only interned identifiers that are not keywords.
+  StringSlice name = slice->identifiers[id];
+  Interner::Entry* entry = builder()->identifier_interner()->Lookup(
+      name.data(), name.length(), slice->identifier_hashes[id], false);
+  if (entry->terminal < 0) {
+    entry->terminal = builder()->RegisterIdentifier(name);
+  }
+  return entry->terminal;
+}
+
+void Scanner::AdoptSlice(Slice* slice, int from) {
+  List<TokenInfo> tokens = slice->tokens;
+  Zone* zone = builder()->zone();
+  // The terminals of the slice point into the input or into its zone, so
+  // they can be used as they are once the zone lives on in ours.
+  zone->Adopt(slice->zone);
+
+  // The slice's builder interned each terminal once, in the order of the
+  // tokens that first use it. Merging the terminals in id order registers
+  // them in the same order as a sequential scan, as long as the slice is
+  // adopted from its first token. Otherwise some terminals are first used
+  // by skipped tokens, and the terminals are merged as the tokens use
+  // them. The builtin identifiers have the same ids in every builder.
+  bool merge = (from == 0);
+  List<int> identifier_ids = List<int>::New(zone, slice->identifiers.length());
+  Interner* interner = builder()->identifier_interner();
+  const int kPrefetchDistance = 8;
+  for (int i = 0; i < identifier_ids.length(); i++) {
+    if (merge && i + kPrefetchDistance < identifier_ids.length()) {
+      interner->Prefetch(slice->identifier_hashes[i + kPrefetchDistance]);
+    }
+    if (i < Tokens::kNumberOfBuiltins) {
+      identifier_ids[i] = i;
+    } else {
+      identifier_ids[i] = merge ? MergeIdentifier(slice, i) : -1;
+    }
+  }
+  List<TreeNode*> registry = slice->registry;
+  List<int> literal_ids = List<int>::New(zone, registry.length());
+  for (int i = 0; i < literal_ids.length(); i++) {
+    literal_ids[i] = -1;
+    if (!merge) continue;
+    LiteralIntegerNode* integer = registry[i]->AsLiteralInteger();
+    literal_ids[i] = (integer != NULL)
+        ? builder()->ComputeCanonicalIntegerId(integer->value())
+        : builder()->ComputeCanonicalDoubleId(
+              registry[i]->AsLiteralDouble()->value());
+  }
+
+  // Every string token registers a new string, so the strings of the
+  // adopted tokens are a consecutive run of the slice's strings. Strings
+  // of a token that was dropped at the stop come after the run.
+  int first_string = -1;
+  int string_end = 0;
+  for (int i = from; i < tokens.length(); i++) {
+    Token token = tokens[i].token();
+    if (token == kSTRING || token == kSTRING_INTERPOLATION ||
+        token == kSTRING_INTERPOLATION_END) {
+      if (first_string < 0) first_string = tokens[i].index();
+      string_end = tokens[i].index() + 1;
+    }
+  }
+  int string_shift = 0;
+  if (first_string >= 0) {
+    List<LiteralStringNode*> strings(slice->strings.data() + first_string,
+                                     string_end - first_string);
+    string_shift = builder()->AdoptStrings(strings) - first_string;
+  }
+
+  int shift = tokens_.length() - from;
+  for (int i = from; i < tokens.length(); i++) {
+    TokenInfo info = tokens[i];
+    int id = info.index();
+    switch (info.token()) {
+      case kIDENTIFIER:
+        if (identifier_ids[id] < 0) {
+          identifier_ids[id] = MergeIdentifier(slice, id);
+        }
+        id = identifier_ids[id];
+        break;
+
+      case kINTEGER:
+        if (literal_ids[id] < 0) {
+          literal_ids[id] = builder()->ComputeCanonicalIntegerId(
+              registry[id]->AsLiteralInteger()->value());
+        }
+        id = literal_ids[id];
+        break;
+
+      case kDOUBLE:
+        if (literal_ids[id] < 0) {
+          literal_ids[id] = builder()->ComputeCanonicalDoubleId(
+              registry[id]->AsLiteralDouble()->value());
+        }
+        id = literal_ids[id];
+        break;
+
+      case kSTRING:
+      case kSTRING_INTERPOLATION:
+      case kSTRING_INTERPOLATION_END:
+        id += string_shift;
+        break;
+
+      default:
+        break;
+    }
+    tokens_.Add(info.WithIndex(id));
+  }
+  for (int i = from; i < tokens.length(); ) {
+    i = ReplayToken(tokens, i, tokens.length(), shift);
+  }
+}
+
+// Skips the UTF-8 byte order mark and the '#!' line at the start of the
+// input. Returns false if more input is needed to see all of it.
+bool Scanner::SkipPrologue() {
+  ASSERT(index_ == 0);
   if (static_cast<u8>(input_[index_]) == 0xef) {
+    if (!final_ && available_ < 3) return false;
     // UTF-8 BOM
     index_++;
     if (static_cast<u8>(input_[index_++]) != 0xbb ||
@@ -73,17 +702,62 @@ void Scanner::Scan(const char* input, Location start_location) {
       builder()->ReportError(start_location_, "Bad UTF-8 BOM");
     }
   }
+  if (!final_ && index_ >= available_) {
+    index_ = 0;
+    return false;
+  }
   if (input_[index_] == '#') {
     int peek = Advance();
     while (peek != '\n' && peek != kEOF) {
       peek = Advance();
     }
-    Advance();
+    if (peek == kEOF && !final_) {
+      index_ = 0;
+      return false;
+    }
+    if (peek == '\n') Advance();
   }
-  while (ScanToken()) {
-    // Keep going.
+  return true;
+}
+
+void Scanner::ScanAvailable() {
+  if (skip_prologue_) {
+    if (!SkipPrologue()) return;
+    skip_prologue_ = false;
   }
-  AddToken(kEOF);
+  while (true) {
+    int index = index_;
+    int token_count = tokens_.length();
+    int string_count = builder()->string_count();
+    undo_log_.Clear();
+    suspended_ = false;
+    bool more = ScanToken();
+    if (suspended_ || AtChunkEnd()) {
+      Rollback(index, token_count, string_count);
+      return;
+    }
+    if (!more) return;
+  }
+}
+
+void Scanner::Rollback(int index, int token_count, int string_count) {
+  while (!undo_log_.is_empty()) {
+    UndoEntry entry = undo_log_.RemoveLast();
+    switch (entry.kind) {
+      case kUndoPush:
+        begin_marker_stack_.RemoveLast();
+        break;
+      case kUndoPop:
+        begin_marker_stack_.Add(entry.marker);
+        break;
+      case kUndoSet:
+        tokens_.Set(entry.marker.pos, entry.info);
+        break;
+    }
+  }
+  while (tokens_.length() > token_count) tokens_.RemoveLast();
+  builder()->TruncateStrings(string_count);
+  index_ = index;
 }
 
 bool Scanner::ScanUntil(int end) {
@@ -96,27 +770,30 @@ bool Scanner::ScanUntil(int end) {
 
 bool Scanner::ScanToken() {
   begin_index_ = index_;
+  if (interpolation_depth_ == 0) first_token_ = tokens_.length();
   int peek = input_[index_];
+  int classes = kCharacterClasses[static_cast<u8>(peek)];
+  if ((classes & kIdentifierStartClass) != 0) {
+    // May be raw string.
+    if (peek == 'r' && IsStringStart(Peek())) {
+      return ScanString(peek, /* raw */ true);
+    }
+    return ScanIdentifier(peek);
+  }
+  if ((classes & kWhitespaceClass) != 0) {
+    SkipWhitespace(peek);
+    return true;
+  }
+  if ((classes & kDecimalDigitClass) != 0) return ScanNumber(peek);
+  if ((classes & kStringStartClass) != 0) {
+    return ScanString(peek, /* raw */ false);
+  }
+
   switch (peek) {
     case 0:
       // End of file.
       return false;
 
-    case '\t':
-    case '\n':
-    case '\r':
-    case ' ':
-      SkipWhitespace(peek);
-      return true;
-
-    case '$':
-    case '_':
-      return ScanIdentifier(peek);
-
-    case '\'':
-    case '"':
-      return ScanString(peek, /* raw */ false);
-
     case '.':
       if (IsDecimalDigit(Peek())) return ScanNumber('.');
       break;
@@ -125,162 +802,169 @@ bool Scanner::ScanToken() {
       if (Peek() == '/') return SkipSinglelineComment(peek);
       if (Peek() == '*') return SkipMultilineComment(peek);
       break;
-
-    // May be raw string.
-    case 'r':
-      if (IsStringStart(Peek())) return ScanString(peek, /* raw */ true);
-      break;
   }
 
-  // Having these inside the switch is not only verbose, it's also 4% slower.
-  if (peek >= '0' && peek <= '9') return ScanNumber(peek);
-  if (peek >= 'A' && peek <= 'Z') return ScanIdentifier(peek);
-  if (peek >= 'a' && peek <= 'z') return ScanIdentifier(peek);
-
   return ScanPunctuation(peek);
 }
 
 bool Scanner::ScanPunctuation(int peek) {
-  Punctuation* trie = punctuation_trie_.LookupChild(peek);
-  if (trie != NULL) {
-    while (Punctuation* next = trie->LookupChild(Peek())) {
-      trie = next;
+  Token token = static_cast<Token>(kPunctuationStart[static_cast<u8>(peek)]);
+  if (token != kEOF) {
+    while (true) {
+      int column = kPunctuationColumn[static_cast<u8>(Peek())];
+      const PunctuationState& state = kPunctuationStates[token - kCOMMA];
+      Token next = static_cast<Token>(state.next[column]);
+      if (next == kEOF) break;
+      token = next;
       Advance();
     }
-    if (trie->HasTerminal()) {
-      Token t = trie->terminal();
-      if (t == kSHR) {
-        // Decompose >> into two tokens in case they are closing angle
-        // brackets.  They may be reunited by the parser later.
-        PopTokenBeginMarker(kLT);
-        AddToken(kGT_START);
-        PopTokenBeginMarker(kLT);
-        AddToken(kGT);
-      } else {
-        if (trie->HasPop()) PopTokenBeginMarker(trie->pop());
-        else if (trie->HasPush()) PushTokenBeginMarker(trie->push());
-        AddToken(t);
+    if (token == kSHR) {
+      // Decompose >> into two tokens in case they are closing angle
+      // brackets.  They may be reunited by the parser later.
+      PopTokenBeginMarker(kLT, tokens_.length());
+      AddToken(kGT_START);
+      PopTokenBeginMarker(kLT, tokens_.length());
+      AddToken(kGT);
+    } else {
+      const PunctuationState& state = kPunctuationStates[token - kCOMMA];
+      if (state.pop != kEOF) {
+        PopTokenBeginMarker(static_cast<Token>(state.pop),
+                            tokens_.length());
+      } else if (state.push != kEOF) {
+        PushTokenBeginMarker(static_cast<Token>(state.push),
+                             tokens_.length());
       }
-      return (Advance() != 0);
+      AddToken(token);
     }
+    return (Advance() != 0);
   }
-  builder()->ReportError(start_location_ + index_,
-                         "Unrecognized character: 0x%x",
-                         peek);
-  return false;
+  Error(start_location_ + index_, "Unrecognized character: 0x%x", peek);
+  if (suspended_) return false;
+  // Skip the character, with the rest of its UTF-8 sequence, and go on
+  // scanning to find the errors after it.
+  do {
+    peek = Advance();
+  } while ((peek & 0xC0) == 0x80);
+  return (peek != 0);
 }
 
-void Scanner::PushTokenBeginMarker(Token token) {
-  TokenBeginMarker marker = { token, tokens_.length() };
-  begin_marker_stack_.Add(marker);
+void Scanner::PushTokenBeginMarker(Token token, int position) {
+  TokenBeginMarker marker = { token, position };
+  PushMarker(marker);
 }
 
-void Scanner::PopTokenBeginMarker(Token token) {
+void Scanner::PopTokenBeginMarker(Token token, int position) {
   while (!begin_marker_stack_.is_empty()) {
     TokenBeginMarker marker = begin_marker_stack_.last();
     if (marker.token == token) {
-      begin_marker_stack_.RemoveLast();
-      int offset = tokens_.length() - marker.pos;
-      TokenInfo info(offset << 8 | token, tokens_.Get(marker.pos).location());
-      tokens_.Set(marker.pos, info);
+      PopMarker();
+      int offset = position - marker.pos;
+      SetToken(marker.pos, tokens_.Get(marker.pos).WithIndex(offset));
       break;
     }
     if (token == kLT) break;
     if (marker.token != kLT && marker.token > token) break;
-    begin_marker_stack_.RemoveLast();
+    PopMarker();
+  }
+}
+
+void Scanner::PushMarker(TokenBeginMarker marker) {
+  if (!final_) {
+    UndoEntry entry = { kUndoPush, marker, TokenInfo() };
+    undo_log_.Add(entry);
+  }
+  begin_marker_stack_.Add(marker);
+}
+
+Scanner::TokenBeginMarker Scanner::PopMarker() {
+  TokenBeginMarker marker = begin_marker_stack_.RemoveLast();
+  if (!final_) {
+    UndoEntry entry = { kUndoPop, marker, TokenInfo() };
+    undo_log_.Add(entry);
+  }
+  return marker;
+}
+
+void Scanner::SetToken(int pos, TokenInfo info) {
+  if (!final_) {
+    TokenBeginMarker marker = { kEOF, pos };
+    UndoEntry entry = { kUndoSet, marker, tokens_.Get(pos) };
+    undo_log_.Add(entry);
   }
+  tokens_.Set(pos, info);
+}
+
+bool Scanner::Error(Location location, const char* format, ...) {
+  if (AtChunkEnd()) return Suspend();
+  // A speculative scan may have guessed wrong; the scan that adopts the
+  // slice reports the error if it is real.
+  if (speculative_) return Suspend();
+  va_list args;
+  va_start(args, format);
+  builder()->ReportError(location, format, args);
+  va_end(args);
+  return false;
 }
 
 Scanner::Scanner(Zone* zone, Builder* builder)
     : builder_(builder)
     , tokens_(zone)
     , begin_marker_stack_(zone)
-    , string_literal_buffer_(zone)
-    , punctuation_trie_(zone) {
-#define T(name, string, prescedence) punctuation_trie_.Populate(zone, name, string);
-  PUNCTUATION_LIST(T)
-#undef T
-  AddPair("(", ")");
-  AddPair("<", ">");
-  AddPair("{", "}");
+    , undo_log_(zone) {
 }
 
-void Scanner::AddPair(const char* push, const char* pop) {
-  Punctuation* trie;
-  // Find opening trie.
-  for (trie = &punctuation_trie_; *push != '\0'; push++) {
-    trie = trie->LookupChild(*push);
-  }
-  Token token = trie->terminal();
-  // When we hit the opening token we should push it.
-  trie->set_push(token);
-  // Find closing trie.
-  for (trie = &punctuation_trie_; *pop != '\0'; pop++) {
-    trie = trie->LookupChild(*pop);
-  }
-  // When we hit the closing token we should pop the opening token.
-  trie->set_pop(token);
+Scanner::~Scanner() {
+  free(buffer_);
 }
 
 void Scanner::AddToken(Token token, int value) {
-  TokenInfo info(value << 8 | token, start_location_ + begin_index_);
+  u32 continuation =
+      tokens_.length() > first_token_ ? TokenInfo::kContinuationBit : 0;
+  TokenInfo info(static_cast<u32>(value) << 8 | token | continuation,
+                 start_location_ + begin_index_);
   tokens_.Add(info);
 }
 
 bool Scanner::ScanNumber(int peek) {
   int start = index_;
-  Zone* trie_zone = builder()->zone();
-  TerminalTrieNode* node = builder()->number_trie();
-  if (!IsDecimalDigit(peek)) {
-    node = node->Child(trie_zone, '0');
-  } else {
-    do {
-      node = node->Child(trie_zone, peek);
-      peek = Advance();
-    } while (IsDecimalDigit(peek));
-  }
+  while (IsDecimalDigit(peek)) peek = Advance();
   bool is_double = false;
   int base = 10;
-  if ((index_ - start == 1) && (peek == 'x' || peek == 'X')) {
+  if ((index_ - start == 1) && input_[start] == '0' &&
+      (peek == 'x' || peek == 'X')) {
     base = 16;
     peek = Advance();
-    while (IsHexDigit(peek)) {
-      node = node->Child(trie_zone, peek);
-      peek = Advance();
-    }
+    while (IsHexDigit(peek)) peek = Advance();
   } else if (peek == '.' && IsDecimalDigit(Peek())) {
     is_double = true;
-    node = node->Child(trie_zone, peek);
     peek = Advance();
-    while (IsDecimalDigit(peek)) {
-      node = node->Child(trie_zone, peek);
-      peek = Advance();
-    }
+    while (IsDecimalDigit(peek)) peek = Advance();
   }
   if (base == 10 && (peek == 'e' || peek == 'E')) {
     is_double = true;
     peek = Advance();
     if (peek == '-' || peek == '+') peek = Advance();
-    while (IsDecimalDigit(peek)) {
-      node = node->Child(trie_zone, peek);
-      peek = Advance();
-    }
+    while (IsDecimalDigit(peek)) peek = Advance();
   }
-  int terminal = node->terminal_;
-  if (terminal < 0) {
-    // TODO(kasperl): Avoid the copy.
-    const char* str = AllocateTerminal(start, index_);
-    if (is_double) {
-      double value = strtod(str, NULL);
-      terminal = node->terminal_ = builder()->RegisterDouble(value);
-    } else {
-      i64 value = strtoll(str, NULL, base);
-      if (errno == ERANGE) {
-        builder()->ReportError(start_location_ + start,
-                               "Unhandled large integer literal");
-      }
-      terminal = node->terminal_ = builder()->RegisterInteger(value);
+  // Don't register a literal that may continue in the next chunk.
+  if (AtChunkEnd()) return Suspend();
+  // Convert directly from the input.
+  const char* digits = input_ + start;
+  int length = index_ - start;
+  int terminal;
+  if (is_double) {
+    double value = NumberConversion::ParseDouble(digits, length);
+    terminal = builder()->ComputeCanonicalDoubleId(value);
+  } else {
+    if (base == 16) {
+      digits += 2;
+      length -= 2;
+    }
+    i64 value = 0;
+    if (!NumberConversion::ParseInteger(digits, length, base, &value)) {
+      Error(start_location_ + start, "Unhandled large integer literal");
     }
+    terminal = builder()->ComputeCanonicalIntegerId(value);
   }
   AddToken(is_double ? kDOUBLE : kINTEGER, terminal);
   return (peek != 0);
@@ -289,26 +973,29 @@ bool Scanner::ScanNumber(int peek) {
 bool Scanner::ScanIdentifier(int peek, bool allow_dollar) {
   ASSERT(IsIdentifierStart(peek));
   int start = index_;
-  Zone* trie_zone = builder()->zone();
-  TerminalTrieNode* node = builder()->identifier_trie();
   if (allow_dollar) {
     do {
-      node = node->Child(trie_zone, peek);
       peek = Advance();
     } while (IsIdentifierPart(peek));
   } else {
     do {
-      node = node->Child(trie_zone, peek);
       peek = Advance();
-    } while (IsIdentifierPart(peek) && peek != '$');
+    } while (IsInterpolationPart(peek));
   }
-  if (node->is_keyword_) {
-    AddToken(static_cast<Token>(node->terminal_));
+  // Don't intern an identifier that may continue in the next chunk.
+  if (AtChunkEnd()) return Suspend();
+  const char* name = input_ + start;
+  int length = index_ - start;
+  Token keyword = Tokens::LookupKeyword(name, length);
+  if (keyword != kIDENTIFIER) {
+    AddToken(keyword);
   } else {
-    int terminal = node->terminal_;
+    Interner::Entry* entry =
+        builder()->identifier_interner()->Lookup(name, length, OwnsInput());
+    int terminal = entry->terminal;
     if (terminal < 0) {
-      terminal = node->terminal_ = builder()->RegisterIdentifier(
-          AllocateTerminal(start, index_));
+      terminal = entry->terminal = builder()->RegisterIdentifier(
+          StringSlice(entry->data, entry->length));
     }
     AddToken(kIDENTIFIER, terminal);
   }
@@ -342,11 +1029,17 @@ bool Scanner::ScanString(int peek, bool raw) {
     }
   }
   bool interpolation = false;
-  // If the list is non-raw and escape sequences is hit, parsed_chars is
-  // used to build the string.
-  string_literal_buffer_.Clear();
+  // Set if the current part of the string has escape sequences that
+  // need decoding.
+  bool escaped = false;
+  // Set if the current part has an invalid escape sequence. It is kept
+  // as it is instead of decoded.
+  bool invalid = false;
   while (peek != 0) {
-    peek = Advance();
+    // Skip ahead to the next byte that may end the string or start an
+    // escape or an interpolation.
+    index_ = Simd::FindStringDelimiter(input_ + index_ + 1, quote) - input_;
+    peek = input_[index_];
     if (peek == quote) {
       int end = index_;
       if (multiline) {
@@ -358,112 +1051,201 @@ bool Scanner::ScanString(int peek, bool raw) {
         }
       }
       Token token = interpolation ? kSTRING_INTERPOLATION_END : kSTRING;
-      NewString(token, start, end);
+      NewString(token, start, end, escaped && !invalid);
       return (Advance() != 0);
     } else if (!raw) {
       if (peek == '\\') {
-        if (string_literal_buffer_.is_empty()) {
-          // Copy up to index_.
-          for (int i = start; i < index_; i++) {
-            string_literal_buffer_.Add(input_[i]);
-          }
-        }
+        escaped = true;
         peek = Advance();
-        switch (peek) {
-          case 'b': string_literal_buffer_.Add('\b'); break;
-          case 'f': string_literal_buffer_.Add('\f'); break;
-          case 'n': string_literal_buffer_.Add('\n'); break;
-          case 'r': string_literal_buffer_.Add('\r'); break;
-          case 't': string_literal_buffer_.Add('\t'); break;
-          case 'v': string_literal_buffer_.Add('\v'); break;
-          // TODO(ajohnsen): Handle \x, and \u escape sequences.
-
-          default:
-            string_literal_buffer_.Add(peek);
+        if (!ScanEscape(peek)) {
+          if (suspended_) return false;
+          // Go on from the character that ended the escape sequence,
+          // which may be the quote.
+          invalid = true;
+          index_--;
         }
       } else if (peek == '$') {
-        interpolation = true;
         int end = index_;
         peek = Advance();
         if (IsIdentifierStart(peek)) {
-          NewString(kSTRING_INTERPOLATION, start, end);
+          interpolation = true;
+          NewString(kSTRING_INTERPOLATION, start, end, escaped && !invalid);
           if (!ScanIdentifier(peek, false)) break;
           // Clear state and continue.
-          string_literal_buffer_.Clear();
+          escaped = false;
+          invalid = false;
           start = index_;
           index_--;
           continue;
         }
         if (peek == '{') {
+          interpolation = true;
           Advance();
-          NewString(kSTRING_INTERPOLATION, start, end);
+          NewString(kSTRING_INTERPOLATION, start, end, escaped && !invalid);
           // Simulate {..} on the marker stack.
           TokenBeginMarker marker = {kLBRACE, 0};
-          begin_marker_stack_.Add(marker);
+          PushMarker(marker);
           int indent = begin_marker_stack_.length();
+          interpolation_depth_++;
           while (true) {
             if (!ScanUntil('}')) {
-              builder()->ReportError(
-                  start_location_ + index_, "Unterminated string literal");
-              return false;
+              interpolation_depth_--;
+              return Error(start_location_ + index_,
+                           "Unterminated string literal");
             }
             if (begin_marker_stack_.length() < indent) {
-              builder()->ReportError(
-                  start_location_ + index_, "Bad string interpolation");
-              return false;
+              interpolation_depth_--;
+              return Error(start_location_ + index_,
+                           "Bad string interpolation");
             }
             while (begin_marker_stack_.last().token != kLBRACE) {
-              begin_marker_stack_.RemoveLast();
+              PopMarker();
             }
             if (begin_marker_stack_.length() == indent) break;
             ScanToken();
           }
-          begin_marker_stack_.RemoveLast();
+          interpolation_depth_--;
+          PopMarker();
           // Clear state and continue.
-          string_literal_buffer_.Clear();
+          escaped = false;
+          invalid = false;
           start = index_ + 1;
           continue;
         }
 
-        builder()->ReportError(
-            start_location_ + index_, "Bad string interpolation start");
-      } else if (!string_literal_buffer_.is_empty()) {
-        string_literal_buffer_.Add(peek);
+        Error(start_location_ + index_, "Bad string interpolation start");
+        if (suspended_) return false;
+        // Keep the '$' in the string and go on from the character after it.
+        index_--;
       }
     }
   }
-  builder()->ReportError(
-      start_location_ + index_, "Unterminated string literal");
-  return false;
+  return Error(start_location_ + index_, "Unterminated string literal");
+}
+
+bool Scanner::ScanEscape(int peek) {
+  if (peek == 'x') {
+    if (!IsHexDigit(Advance()) || !IsHexDigit(Advance())) {
+      return Error(start_location_ + index_, "Invalid escape sequence");
+    }
+  } else if (peek == 'u') {
+    if (Peek() != '{') {
+      for (int i = 0; i < 4; i++) {
+        if (!IsHexDigit(Advance())) {
+          return Error(start_location_ + index_, "Invalid escape sequence");
+        }
+      }
+      return true;
+    }
+    Advance();
+    int value = 0;
+    int digits = 0;
+    while (IsHexDigit(peek = Advance())) {
+      if (++digits > 6) break;
+      value = value * 16 + HexDigitValue(peek);
+    }
+    if (peek != '}' || digits == 0 || value > Utf8::kMaxCodePoint) {
+      return Error(start_location_ + index_, "Invalid escape sequence");
+    }
+  }
+  return true;
 }
 
-void Scanner::NewString(Token token, int start, int end) {
-  const char* value;
-  if (string_literal_buffer_.is_empty()) {
+void Scanner::NewString(Token token, int start, int end, bool escaped) {
+  StringSlice value;
+  if (escaped) {
+    value = DecodeString(start, end);
+  } else if (OwnsInput()) {
     value = AllocateTerminal(start, end);
   } else {
-    string_literal_buffer_.Add('\0');
-    value = string_literal_buffer_.ToList(builder()->zone()).data();
+    value = StringSlice(input_ + start, end - start);
   }
   AddToken(token, builder()->RegisterString(value));
 }
 
+StringSlice Scanner::DecodeString(int start, int end) {
+  // No escape sequence is shorter than the UTF-8 it decodes to, so the
+  // length of the source text bounds the length of the value.
+  char* buffer = static_cast<char*>(builder()->zone()->Allocate(end - start));
+  char* out = buffer;
+  int i = start;
+  while (i < end) {
+    char c = input_[i++];
+    if (c != '\\') {
+      *out++ = c;
+      continue;
+    }
+    c = input_[i++];
+    switch (c) {
+      case 'b': *out++ = '\b'; break;
+      case 'f': *out++ = '\f'; break;
+      case 'n': *out++ = '\n'; break;
+      case 'r': *out++ = '\r'; break;
+      case 't': *out++ = '\t'; break;
+      case 'v': *out++ = '\v'; break;
+      case 'x': {
+        int value =
+            HexDigitValue(input_[i]) * 16 + HexDigitValue(input_[i + 1]);
+        i += 2;
+        out += Utf8::Encode(value, out);
+        break;
+      }
+      case 'u': {
+        int value = DecodeCodeUnit(&i);
+        // A \u escape for a high surrogate followed by one for a low
+        // surrogate is a single code point.
+        if (value >= 0xD800 && value <= 0xDBFF && i + 1 < end &&
+            input_[i] == '\\' && input_[i + 1] == 'u') {
+          int next = i + 2;
+          int low = DecodeCodeUnit(&next);
+          if (low >= 0xDC00 && low <= 0xDFFF) {
+            value = 0x10000 + ((value - 0xD800) << 10) + (low - 0xDC00);
+            i = next;
+          }
+        }
+        out += Utf8::Encode(value, out);
+        break;
+      }
+      default:
+        *out++ = c;
+    }
+  }
+  ASSERT(out - buffer <= end - start);
+  return StringSlice(buffer, out - buffer);
+}
+
+int Scanner::DecodeCodeUnit(int* index) {
+  int i = *index;
+  int value = 0;
+  if (input_[i] == '{') {
+    for (i++; input_[i] != '}'; i++) {
+      value = value * 16 + HexDigitValue(input_[i]);
+    }
+    i++;
+  } else {
+    for (int end = i + 4; i < end; i++) {
+      value = value * 16 + HexDigitValue(input_[i]);
+    }
+  }
+  *index = i;
+  return value;
+}
+
 void Scanner::SkipWhitespace(int peek) {
   ASSERT(IsWhitespace(peek));
-  do {
-    peek = Advance();
-  } while (IsWhitespace(peek));
+  // Most whitespace runs are a single space, so check the next byte
+  // before starting a vector search.
+  peek = Advance();
+  if (!IsWhitespace(peek)) return;
+  index_ = Simd::SkipWhitespace(input_ + index_) - input_;
 }
 
 bool Scanner::SkipSinglelineComment(int peek) {
   ASSERT(peek == '/');
   peek = Advance();
   ASSERT(peek == '/');
-  do {
-    peek = Advance();
-    if (peek == 0) return false;
-  } while (!IsNewline(peek));
-  return true;
+  index_ = Simd::FindNewline(input_ + index_ + 1) - input_;
+  return input_[index_] != 0;
 }
 
 bool Scanner::SkipMultilineComment(int peek) {
@@ -471,39 +1253,38 @@ bool Scanner::SkipMultilineComment(int peek) {
   ASSERT(peek == '/');
   peek = Advance();
   ASSERT(peek == '*');
-  peek = Advance();
+  Advance();
   int nesting = 1;
-  do {
+  while (true) {
+    // Only '*' and '/' can change the nesting, so skip everything else.
+    index_ = Simd::FindCommentDelimiter(input_ + index_) - input_;
+    peek = input_[index_];
+    if (peek == 0) break;
     if (peek == '*') {
       peek = Advance();
       if (peek == '/') {
-        peek = Advance();
+        Advance();
         nesting--;
         if (nesting == 0) return true;
       }
-    } else if (peek == '/') {
+    } else {
+      ASSERT(peek == '/');
       peek = Advance();
       if (peek == '*') {
         // Nested comment.
         nesting++;
-        peek = Advance();
+        Advance();
       }
-    } else {
-      // Just skip to the next one.
-      peek = Advance();
     }
-  } while (peek != 0);
-  builder()->ReportError(
-      start_location_ + start, "Unterminated multiline comment");
-  return false;
+  }
+  return Error(start_location_ + start, "Unterminated multiline comment");
 }
 
-const char* Scanner::AllocateTerminal(int start, int end) {
+StringSlice Scanner::AllocateTerminal(int start, int end) {
   int length = end - start;
-  char* buffer = static_cast<char*>(builder()->zone()->Allocate(length + 1));
+  char* buffer = static_cast<char*>(builder()->zone()->Allocate(length));
   memcpy(buffer, input_ + start, length);
-  buffer[length] = 0;
-  return buffer;
+  return StringSlice(buffer, length);
 }
 
 }  // namespace rart
@@ -9,66 +9,175 @@
 #include "src/list.h"
 #include "src/list_builder.h"
 #include "src/tokens.h"
-#include "src/trie.h"
 #include "src/zone.h"
 
 namespace rart {
 
-class Punctuation : public TrieNode<Punctuation> {
- public:
-  void Populate(Zone* zone, Token token, const char* string);
-  explicit Punctuation(Zone* zone) : TrieNode<Punctuation>(zone) {}
-
-  bool HasTerminal() { return terminal_ != kEOF; }
-
-  Token terminal() {
-    ASSERT(HasTerminal());
-    return terminal_;
-  }
-
-  Token pop() { return pop_; }
-  Token push() { return push_; }
-  bool HasPop() { return pop_ != kEOF; }
-  bool HasPush() { return push_ != kEOF; }
-  void set_pop(Token pop) { pop_ = pop; }
-  void set_push(Token push) { push_ = push; }
-
- private:
-  Token terminal_ = kEOF;
-  Token pop_ = kEOF;
-  Token push_ = kEOF;
-};
+class TokenColumns;
 
 class Scanner : public StackAllocated {
  public:
   Scanner(Zone* zone, Builder* builder);
+  ~Scanner();
+
+  // Identifiers and strings without escapes are registered as slices
+  // of the input, so the input has to stay alive as long as the builder.
   void Scan(const char* input, Location start_location);
 
+  // Resumable scanning of input that arrives in chunks. Begin starts a
+  // new scan at the given location and Feed scans as much of the chunk
+  // as it can. A token that may continue in the next chunk is rescanned
+  // once more input has arrived. End scans the rest of the input and
+  // adds the EOF token. Only the unscanned tail of the input is kept
+  // around between chunks, so terminals are copied out of it.
+  void Begin(Location start_location);
+  void Feed(const char* chunk, int length);
+  void End();
+
+  // Scans input that was made by replacing 'deleted' bytes at 'offset' in
+  // the input of a previous scan with 'inserted' bytes. The previous
+  // tokens must come from scanning the old input at the same start
+  // location with the same builder. Scanning restarts shortly before the
+  // edit and stops as soon as it reaches a token start that the previous
+  // scan also had; the tokens on either side are copied, and the bracket
+  // offsets are recomputed for them as they are copied. Copied tokens
+  // keep referring to the terminals of the old input.
+  void Rescan(List<TokenInfo> previous, const char* input,
+              Location start_location, int offset, int deleted,
+              int inserted);
+
+  // Scans the input on the given number of threads. The input is cut into
+  // slices at line starts, and all slices but the first are scanned on
+  // their own threads with their own zones and builders, guessing that a
+  // slice does not start inside a string or a comment. The slices are
+  // stitched together in order. Where a guess was wrong, the input is
+  // scanned again until the tokens agree with the slice. Stitching adopts
+  // the zone of a slice and merges the terminals it interned into this
+  // scanner's builder once per distinct terminal, in the order a
+  // sequential scan registers them, so the result is the same as the
+  // result of Scan.
+  void ScanParallel(const char* input, Location start_location, int threads);
+
   List<TokenInfo> EncodedTokens();
 
+  // Returns the tokens split into parallel arrays for the parser.
+  TokenColumns EncodedTokenColumns();
+
  private:
+  struct Slice;
+
   struct TokenBeginMarker {
     Token token;
     int pos;
   };
 
+  // While streaming, the changes a token makes to the begin marker stack
+  // and to earlier tokens are logged, so they can be undone if the token
+  // has to be rescanned.
+  enum UndoKind {
+    kUndoPush,
+    kUndoPop,
+    kUndoSet
+  };
+
+  struct UndoEntry {
+    UndoKind kind;
+    TokenBeginMarker marker;
+    TokenInfo info;
+  };
+
+  // No token looks at more than this many characters beyond the end of
+  // the token.
+  static const int kMaxLookahead = 2;
+
+  static const int kInitialBufferSize = 16 * KB;
+
   Builder* const builder_;
 
   ListBuilder<TokenInfo, 1 * KB> tokens_;
   ListBuilder<TokenBeginMarker, 32> begin_marker_stack_;
-  ListBuilder<char, 256> string_literal_buffer_;
+  ListBuilder<UndoEntry, 16> undo_log_;
 
   const char* input_ = NULL;
   int index_ = -1;
   int begin_index_;
   Location start_location_;
-  Punctuation punctuation_trie_;
+
+  // Streaming state. The buffer holds the unscanned input; the first
+  // 'available_' bytes are valid and followed by a zero byte.
+  char* buffer_ = NULL;
+  int capacity_ = 0;
+  int available_ = 0;
+  bool final_ = true;
+  bool skip_prologue_ = false;
+  bool suspended_ = false;
+
+  // Tokens added after the first token of a top level ScanToken are
+  // marked as continuations. Scanning inside a string interpolation does
+  // not start a new top level token.
+  int first_token_ = 0;
+  int interpolation_depth_ = 0;
+
+  // A speculative scan stops at errors instead of reporting them.
+  bool speculative_ = false;
 
   Builder* builder() const { return builder_; }
 
+  // Terminals refer to the characters of the input unless the input is
+  // the scanner's own streaming buffer.
+  bool OwnsInput() const { return buffer_ != NULL; }
+
+  // Returns true if the current token may have seen the end of the input
+  // that has arrived so far, and more input may follow.
+  bool AtChunkEnd() const {
+    return !final_ && index_ + kMaxLookahead >= available_;
+  }
+
+  // Gives up on the current token until more input arrives.
+  bool Suspend() {
+    suspended_ = true;
+    return false;
+  }
+
   inline int Advance() { return input_[++index_]; }
   inline int Peek(int offset = 1) { return input_[index_ + offset]; }
 
+  bool SkipPrologue();
+  void ScanAvailable();
+  void Rollback(int index, int token_count, int string_count);
+
+  // Returns the offset in the input of a token from a previous scan.
+  int OffsetOf(TokenInfo info) const {
+    return static_cast<int>(info.location().raw() - start_location_.raw());
+  }
+
+  // Returns the index of the last token of a previous scan that can be
+  // scanned again to rescan an edit at 'offset', or -1 if the whole input
+  // must be scanned again.
+  int FindRestart(List<TokenInfo> previous, int offset) const;
+
+  // Redoes the begin marker stack changes of a token of a previous scan
+  // that has been copied 'shift' tokens further along in tokens_, and
+  // returns the index of the next token to replay. Brackets that the
+  // previous scan matched before 'end' are skipped together with their
+  // contents.
+  int ReplayToken(List<TokenInfo> previous, int index, int end, int shift);
+
+  static void* RunSlice(void* slice);
+
+  // Speculatively scans the tokens that start in [begin, end). Returns
+  // the position the scan stopped at, which is where the next token would
+  // have been scanned from.
+  int ScanSlice(const char* input, Location start_location, int begin,
+                int end);
+
+  // Adds the tokens of a slice, starting at the given token, with their
+  // terminals merged into this scanner's builder.
+  void AdoptSlice(Slice* slice, int from);
+
+  // Returns the id in this scanner's builder of an identifier of a slice.
+  int MergeIdentifier(Slice* slice, int id);
+
   bool ScanUntil(int end = 0);
   bool ScanToken();
 
@@ -79,27 +188,79 @@ class Scanner : public StackAllocated {
 
   void AddToken(Token token, int value = -1);
 
-  void AddPair(const char* push, const char* pop);
+  // The position is the index of the bracket token being pushed or
+  // popped.
+  void PushTokenBeginMarker(Token token, int position);
+  void PopTokenBeginMarker(Token token, int position);
+
+  void PushMarker(TokenBeginMarker marker);
+  TokenBeginMarker PopMarker();
+  void SetToken(int pos, TokenInfo info);
 
-  void PushTokenBeginMarker(Token token);
-  void PopTokenBeginMarker(Token token);
+  // Reports an error, unless the error may be caused by the input ending
+  // too early, in which case the token is suspended. Returns false.
+  bool Error(Location location, const char* format, ...);
 
-  // Create a new string token. If string_literal_buffer_ is not empty, the
-  // string is created from that buffer. If it's empty, (start, end) is used to
-  // grab a substring from the input.
-  void NewString(Token token, int start, int end);
+  // Checks the escape sequence whose first character (after the
+  // backslash) is peek, leaving index_ on its last character.
+  bool ScanEscape(int peek);
+
+  // Create a new string token from the input in (start, end). The value
+  // is a slice of the input, unless the string has escape sequences that
+  // have to be decoded into a copy.
+  void NewString(Token token, int start, int end, bool escaped);
+  StringSlice DecodeString(int start, int end);
+
+  // Decodes the hex digits of a \u escape starting at *index, either
+  // four of them or a braced sequence, and moves *index past them.
+  int DecodeCodeUnit(int* index);
 
   void SkipWhitespace(int peek);
   bool SkipSinglelineComment(int peek);
   bool SkipMultilineComment(int peek);
 
-  const char* AllocateTerminal(int start, int end);
+  // Copies a terminal out of the input. Only needed when streaming,
+  // because the scanner then owns the input buffer and reuses it.
+  StringSlice AllocateTerminal(int start, int end);
+};
+
+// The tokens of a scan stored as a structure of arrays: the token
+// kinds are a dense byte array next to separate arrays of indexes and
+// locations. Most of the parser only looks at kinds, so lookahead gets
+// 64 tokens per cache line instead of 8.
+class TokenColumns {
+ public:
+  TokenColumns(List<u8> tokens, List<int> indexes, List<Location> locations)
+      : tokens_(tokens)
+      , indexes_(indexes)
+      , locations_(locations) {
+    ASSERT(tokens.length() == indexes.length());
+    ASSERT(tokens.length() == locations.length());
+  }
+
+  // Splits encoded tokens into columns allocated in the zone. The
+  // continuation bits are dropped.
+  static TokenColumns Split(Zone* zone, List<TokenInfo> encoded);
+
+  int length() const { return tokens_.length(); }
+
+  List<u8> tokens() const { return tokens_; }
+  List<int> indexes() const { return indexes_; }
+  List<Location> locations() const { return locations_; }
+
+ private:
+  List<u8> tokens_;
+  List<int> indexes_;
+  List<Location> locations_;
 };
 
 class TokenStream : public StackAllocated {
  public:
-  explicit TokenStream(List<TokenInfo> encoded)
-      : encoded_(encoded)
+  explicit TokenStream(TokenColumns columns)
+      : tokens_(columns.tokens().data())
+      , indexes_(columns.indexes().data())
+      , locations_(columns.locations().data())
+      , length_(columns.length())
       , position_(0) {
   }
 
@@ -110,22 +271,25 @@ class TokenStream : public StackAllocated {
   void Skip(int n) { position_ += n; }
 
   Token Current() const {
-    ASSERT(position_ < encoded_.length());
-    return encoded_[position_].token();
+    ASSERT(position_ < length_);
+    return static_cast<Token>(tokens_[position_]);
   }
 
   int CurrentIndex() const {
-    ASSERT(position_ < encoded_.length());
-    return encoded_[position_].index();
+    ASSERT(position_ < length_);
+    return indexes_[position_];
   }
 
   Location CurrentLocation() const {
-    ASSERT(position_ < encoded_.length());
-    return encoded_[position_].location();
+    ASSERT(position_ < length_);
+    return locations_[position_];
   }
 
  private:
-  const List<TokenInfo> encoded_;
+  const u8* const tokens_;
+  const int* const indexes_;
+  const Location* const locations_;
+  const int length_;
   int position_;
 };
 
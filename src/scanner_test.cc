@@ -4,7 +4,11 @@
 
 #define TESTING
 
+#include <stdio.h>
+#include <string.h>
+
 #include "src/assert.h"
+#include "src/os.h"
 #include "src/scanner.h"
 #include "src/string_buffer.h"
 #include "src/test_case.h"
@@ -21,7 +25,7 @@ List<TokenData> Scan(Zone* zone, const char* input) {
   Builder builder(zone);
   Scanner scanner(zone, &builder);
   scanner.Scan(input, Location());
-  TokenStream stream(scanner.EncodedTokens());
+  TokenStream stream(scanner.EncodedTokenColumns());
   ListBuilder<TokenData, 4> tokens(zone);
   while (true) {
     Token token = stream.Current();
@@ -30,7 +34,7 @@ List<TokenData> Scan(Zone* zone, const char* input) {
     if (token == kSTRING ||
         token == kSTRING_INTERPOLATION ||
         token == kSTRING_INTERPOLATION_END) {
-      value = builder.LookupString(index)->value();
+      value = builder.LookupString(index)->value().ToCString(zone);
     } else if (token == kINTEGER) {
       StringBuffer buffer(zone);
       buffer.Print("%d", builder.Lookup(index)->AsLiteralInteger()->value());
@@ -40,7 +44,7 @@ List<TokenData> Scan(Zone* zone, const char* input) {
       buffer.Print("%F", builder.Lookup(index)->AsLiteralDouble()->value());
       value = buffer.ToString();
     } else if (token == kIDENTIFIER) {
-      value = builder.LookupIdentifier(index);
+      value = builder.LookupIdentifier(index).ToCString(zone);
     }
     TokenData current = { token, index, value };
     tokens.Add(current);
@@ -341,6 +345,65 @@ TEST_CASE(StringLiterals) {
   EXPECT_EQ(kEOF, tokens[1].token);
 }
 
+TEST_CASE(StringEscapes) {
+  Zone zone;
+  List<TokenData> tokens = Scan(&zone, "'\\x41\\x7e\\xe9'");
+  EXPECT_EQ(2, tokens.length());
+  EXPECT_STREQ("A~\xc3\xa9", tokens[0].value);
+
+  tokens = Scan(&zone, "'\\u0041\\u20AC\\u{1F600}\\u{41}'");
+  EXPECT_STREQ("A\xe2\x82\xac\xf0\x9f\x98\x80" "A", tokens[0].value);
+
+  // A surrogate pair decodes to one code point.
+  tokens = Scan(&zone, "'\\uD83D\\uDE00'");
+  EXPECT_STREQ("\xf0\x9f\x98\x80", tokens[0].value);
+
+  tokens = Scan(&zone, "'\\'\\$\\q\\\\'");
+  EXPECT_STREQ("'$q\\", tokens[0].value);
+
+  // Raw strings and unescaped parts of interpolations are not decoded.
+  tokens = Scan(&zone, "r'\\x41' '\\x41$x\\x42${y}\\u{43}'");
+  EXPECT_EQ(7, tokens.length());
+  EXPECT_STREQ("\\x41", tokens[0].value);
+  EXPECT_EQ(kSTRING_INTERPOLATION, tokens[1].token);
+  EXPECT_STREQ("A", tokens[1].value);
+  EXPECT_STREQ("B", tokens[3].value);
+  EXPECT_EQ(kSTRING_INTERPOLATION_END, tokens[5].token);
+  EXPECT_STREQ("C", tokens[5].value);
+}
+
+TEST_CASE(TerminalSlices) {
+  Zone zone;
+  const char* input = "foo 'bar' foo '\\x41' \"$foo\"";
+  Builder builder(&zone);
+  Scanner scanner(&zone, &builder);
+  scanner.Scan(input, Location());
+  // Identifiers and plain strings point into the input; only the
+  // decoded string is a copy.
+  int id = builder.ComputeCanonicalId(StringSlice("foo"));
+  StringSlice foo = builder.LookupIdentifier(id);
+  EXPECT_EQ(input, foo.data());
+  EXPECT_EQ(3, foo.length());
+  EXPECT_EQ(input + 5, builder.LookupString(0)->value().data());
+  EXPECT_EQ(3, builder.LookupString(0)->value().length());
+  StringSlice decoded = builder.LookupString(1)->value();
+  EXPECT(decoded.data() < input || decoded.data() > input + strlen(input));
+  EXPECT(decoded.Equals("A"));
+  EXPECT_EQ(input + 22, builder.LookupString(2)->value().data());
+  EXPECT_EQ(input + 26, builder.LookupString(3)->value().data());
+
+  // When streaming, the scanner reuses its buffer, so terminals are
+  // copied.
+  Builder streaming_builder(&zone);
+  Scanner streaming_scanner(&zone, &streaming_builder);
+  streaming_scanner.Begin(Location());
+  streaming_scanner.Feed(input, strlen(input));
+  streaming_scanner.End();
+  StringSlice bar = streaming_builder.LookupString(0)->value();
+  EXPECT(bar.Equals("bar"));
+  EXPECT(bar.data() < input || bar.data() > input + strlen(input));
+}
+
 TEST_CASE(StringInterpolation) {
   Zone zone;
   List<TokenData> tokens = Scan(&zone, "r'$x'");
@@ -503,4 +566,457 @@ TEST_CASE(MultilineComments) {
   EXPECT_EQ(kEOF, tokens[2].token);
 }
 
+TEST_CASE(NumberLiterals) {
+  Zone zone;
+  List<TokenData> tokens = Scan(&zone, "16 0x10 010 1.5 15e-1 .15e1 2");
+  EXPECT_EQ(8, tokens.length());
+  EXPECT_EQ(kINTEGER, tokens[0].token);
+  EXPECT_STREQ("16", tokens[0].value);
+  // Literals are canonicalized by value, not by spelling.
+  EXPECT_EQ(tokens[0].index, tokens[1].index);
+  EXPECT_EQ(kINTEGER, tokens[2].token);
+  EXPECT_STREQ("10", tokens[2].value);
+  EXPECT(tokens[0].index != tokens[2].index);
+  EXPECT_EQ(kDOUBLE, tokens[3].token);
+  EXPECT_EQ(tokens[3].index, tokens[4].index);
+  EXPECT_EQ(tokens[3].index, tokens[5].index);
+  EXPECT_EQ(kINTEGER, tokens[6].token);
+  EXPECT_STREQ("2", tokens[6].value);
+  EXPECT_EQ(kEOF, tokens[7].token);
+}
+
+TEST_CASE(Punctuation) {
+  Zone zone;
+  StringBuffer buffer(&zone);
+#define T(n, s, p) buffer.Print("%s ", s);
+PUNCTUATION_LIST(T)
+#undef T
+  List<TokenData> tokens = Scan(&zone, buffer.ToString());
+  int index = 0;
+#define T(n, s, p)                                                      \
+  if (n == kSHR) {                                                      \
+    EXPECT_EQ(kGT_START, tokens[index++].token);                        \
+    EXPECT_EQ(kGT, tokens[index++].token);                              \
+  } else {                                                              \
+    EXPECT_EQ(n, tokens[index++].token);                                \
+  }
+PUNCTUATION_LIST(T)
+#undef T
+  EXPECT_EQ(kEOF, tokens[index++].token);
+  EXPECT_EQ(index, tokens.length());
+
+  tokens = Scan(&zone, "a~/=b..c[]=d>=e=>!");
+  EXPECT_EQ(12, tokens.length());
+  EXPECT_EQ(kASSIGN_TRUNCDIV, tokens[1].token);
+  EXPECT_EQ(kCASCADE, tokens[3].token);
+  EXPECT_EQ(kASSIGN_INDEX, tokens[5].token);
+  EXPECT_EQ(kGTE, tokens[7].token);
+  EXPECT_EQ(kARROW, tokens[9].token);
+  EXPECT_EQ(kNOT, tokens[10].token);
+}
+
+TEST_CASE(Keywords) {
+#define T(n, s, p) EXPECT_EQ(n, Tokens::LookupKeyword(s, strlen(s)));
+KEYWORD_LIST(T)
+#undef T
+  EXPECT_EQ(kIDENTIFIER, Tokens::LookupKeyword("i", 1));
+  EXPECT_EQ(kIDENTIFIER, Tokens::LookupKeyword("iff", 3));
+  EXPECT_EQ(kIDENTIFIER, Tokens::LookupKeyword("classy", 6));
+  EXPECT_EQ(kIDENTIFIER, Tokens::LookupKeyword("Class", 5));
+  EXPECT_EQ(kIDENTIFIER, Tokens::LookupKeyword("implementsx", 11));
+
+  Zone zone;
+  List<TokenData> tokens = Scan(&zone, "class classy abstract $if");
+  EXPECT_EQ(5, tokens.length());
+  EXPECT_EQ(kCLASS, tokens[0].token);
+  EXPECT_EQ(kIDENTIFIER, tokens[1].token);
+  EXPECT_STREQ("classy", tokens[1].value);
+  EXPECT_EQ(kABSTRACT, tokens[2].token);
+  EXPECT_EQ(kIDENTIFIER, tokens[3].token);
+  EXPECT_STREQ("$if", tokens[3].value);
+  EXPECT_EQ(kEOF, tokens[4].token);
+}
+
+TEST_CASE(NestedMultilineComments) {
+  Zone zone;
+  List<TokenData> tokens =
+      Scan(&zone, "1 /* a /* b ** / */ c */ 2 /**/ 3 /***/ 4");
+  EXPECT_EQ(5, tokens.length());
+  EXPECT_STREQ("1", tokens[0].value);
+  EXPECT_STREQ("2", tokens[1].value);
+  EXPECT_STREQ("3", tokens[2].value);
+  EXPECT_STREQ("4", tokens[3].value);
+  EXPECT_EQ(kEOF, tokens[4].token);
+}
+
+TEST_CASE(SinglelineComments) {
+  Zone zone;
+  List<TokenData> tokens = Scan(&zone, "1 // a /* b\r2 //\n3 // 4");
+  EXPECT_EQ(4, tokens.length());
+  EXPECT_STREQ("1", tokens[0].value);
+  EXPECT_STREQ("2", tokens[1].value);
+  EXPECT_STREQ("3", tokens[2].value);
+  EXPECT_EQ(kEOF, tokens[3].token);
+}
+
+TEST_CASE(Whitespace) {
+  Zone zone;
+  // Long enough runs to cover several vector blocks.
+  List<TokenData> tokens = Scan(
+      &zone,
+      "x \t\r\n                                     y"
+      "                                                z\n\n\n\n\n");
+  EXPECT_EQ(4, tokens.length());
+  EXPECT_STREQ("x", tokens[0].value);
+  EXPECT_STREQ("y", tokens[1].value);
+  EXPECT_STREQ("z", tokens[2].value);
+  EXPECT_EQ(kEOF, tokens[3].token);
+}
+
+static const char* kStreamingSource =
+    "\xef\xbb\xbf#!/usr/bin/env dart\n"
+    "import 'dart:core' show int;\n"
+    "/* A /* nested */ comment. */\n"
+    "class Foo<T extends List<List<int>>> {\n"
+    "  final Map<String, int> map = const {'a': 1, \"b\": 0x2F};\n"
+    "  String describe(int x) => 'x is $x and ${x * 2 + map[\"a\"]}!';\n"
+    "  String multi() => \"\"\"\n  multi ${'nested ${1.5e3}'} line\"\"\";\n"
+    "  void run() {\n"
+    "    // Single line comment.\n"
+    "    for (var i = 0; i < 10; i++) { x >>= 1; y ~/= 2; }\n"
+    "    var raw = r'raw $string \\n';\n"
+    "    return identifier_with_a_long_name123 + .25 - 1e-7;\n"
+    "  }\n"
+    "}\n";
+
+static void ExpectSameTokens(List<TokenInfo> expected,
+                             List<TokenInfo> actual) {
+  EXPECT_EQ(expected.length(), actual.length());
+  for (int i = 0; i < expected.length(); i++) {
+    EXPECT_EQ(expected[i].token(), actual[i].token());
+    EXPECT_EQ(expected[i].index(), actual[i].index());
+    EXPECT_EQ(expected[i].location().raw(), actual[i].location().raw());
+  }
+}
+
+TEST_CASE(StreamingScan) {
+  Zone zone;
+  Builder expected_builder(&zone);
+  Scanner expected_scanner(&zone, &expected_builder);
+  expected_scanner.Scan(kStreamingSource, Location());
+  List<TokenInfo> expected = expected_scanner.EncodedTokens();
+
+  int length = strlen(kStreamingSource);
+  for (int chunk_size = 1; chunk_size <= length; chunk_size++) {
+    Zone scan_zone;
+    Builder builder(&scan_zone);
+    Scanner scanner(&scan_zone, &builder);
+    scanner.Begin(Location());
+    for (int i = 0; i < length; i += chunk_size) {
+      scanner.Feed(kStreamingSource + i,
+                   Utils::Minimum(chunk_size, length - i));
+    }
+    scanner.End();
+    ExpectSameTokens(expected, scanner.EncodedTokens());
+    // Partial tokens must not leave strings behind in the registry.
+    EXPECT_EQ(expected_builder.string_count(), builder.string_count());
+  }
+}
+
+// Returns a copy of 'input' with 'deleted' bytes at 'offset' replaced by
+// 'inserted'.
+static const char* Edit(Zone* zone, const char* input, int offset,
+                        int deleted, const char* inserted) {
+  int length = strlen(input);
+  int inserted_length = strlen(inserted);
+  char* result = static_cast<char*>(
+      zone->Allocate(length - deleted + inserted_length + 1));
+  memcpy(result, input, offset);
+  memcpy(result + offset, inserted, inserted_length);
+  strcpy(result + offset + inserted_length, input + offset + deleted);
+  return result;
+}
+
+// Rescans an edit and checks that the result is the same as scanning the
+// edited input from scratch. String literals get a new id every time they
+// are registered, so their ids are not compared.
+static List<TokenInfo> ExpectSameRescan(Zone* zone,
+                                        Builder* builder,
+                                        List<TokenInfo> previous,
+                                        const char* input,
+                                        int offset,
+                                        int deleted,
+                                        const char* inserted) {
+  const char* edited = Edit(zone, input, offset, deleted, inserted);
+  Scanner expected_scanner(zone, builder);
+  expected_scanner.Scan(edited, Location());
+  List<TokenInfo> expected = expected_scanner.EncodedTokens();
+  Scanner scanner(zone, builder);
+  scanner.Rescan(previous, edited, Location(), offset, deleted,
+                 strlen(inserted));
+  List<TokenInfo> actual = scanner.EncodedTokens();
+  EXPECT_EQ(expected.length(), actual.length());
+  int length = Utils::Minimum(expected.length(), actual.length());
+  for (int i = 0; i < length; i++) {
+    Token token = expected[i].token();
+    EXPECT_EQ(token, actual[i].token());
+    EXPECT_EQ(expected[i].is_continuation(), actual[i].is_continuation());
+    EXPECT_EQ(expected[i].location().raw(), actual[i].location().raw());
+    if (token != kSTRING &&
+        token != kSTRING_INTERPOLATION &&
+        token != kSTRING_INTERPOLATION_END) {
+      EXPECT_EQ(expected[i].index(), actual[i].index());
+    }
+  }
+  return actual;
+}
+
+TEST_CASE(IncrementalRescan) {
+  static const char* kInsertions[] = {
+    "x", " ", "\n", "(", ")", "{}", "}", "<", ">>", "'' ", "0.5 ",
+    "/* c */", "\"${'i'}\" "
+  };
+  Zone zone;
+  Builder builder(&zone);
+  Scanner scanner(&zone, &builder);
+  scanner.Scan(kStreamingSource, Location());
+  List<TokenInfo> original = scanner.EncodedTokens();
+
+  // Edit at every token boundary the sample has.
+  int length = strlen(kStreamingSource);
+  for (int offset = 0; offset < length; offset++) {
+    char c = kStreamingSource[offset];
+    if (c != ' ' && c != '\n') continue;
+    ExpectSameRescan(&zone, &builder, original, kStreamingSource,
+                     offset, 1, "");
+    for (size_t i = 0; i < ARRAY_SIZE(kInsertions); i++) {
+      ExpectSameRescan(&zone, &builder, original, kStreamingSource,
+                       offset, 0, kInsertions[i]);
+    }
+  }
+
+  // Apply a series of edits, each one rescanned from the previous result.
+  const char* input = kStreamingSource;
+  List<TokenInfo> tokens = original;
+  for (int offset = length - 1; offset >= 0; offset--) {
+    char c = kStreamingSource[offset];
+    if (c != ' ' && c != '\n') continue;
+    const char* inserted = kInsertions[offset % ARRAY_SIZE(kInsertions)];
+    tokens = ExpectSameRescan(&zone, &builder, tokens, input,
+                              offset, 0, inserted);
+    input = Edit(&zone, input, offset, 0, inserted);
+  }
+}
+
+TEST_CASE(ParallelScan) {
+  Zone zone;
+  StringBuffer buffer(&zone);
+  buffer.Print("%s", kStreamingSource);
+  // Slices that start inside the strings and comments below guess wrong.
+  for (int i = 0; i < 100; i++) {
+    buffer.Print(
+        "class C%d<T extends List<List<int>>> {\n"
+        "  String s = \"\"\"\n"
+        "  it's \"multi\" ${'line'} // not a comment\n"
+        "  /* not a comment either\n"
+        "  \"\"\";\n"
+        "  /* A comment with 'quotes\n"
+        "     and \"\"\" and ${ braces\n"
+        "   */\n"
+        "  int f(int x) => (x + %d) * [1, 2.5, 3].length;\n"
+        "  var m = {'a': r'raw\n"
+        "  line', 'b': \"${x} and\n"
+        "  ${{'c': 1}['c']}\"};\n"
+        "}\n",
+        i, i);
+    // Slices guess nothing about errors; they are reported by the scan
+    // that adopts the slice.
+    if (i % 10 == 0) buffer.Print("var e%d = 1 ` 0x123456789abcdef01;\n", i);
+  }
+  const char* input = buffer.ToString();
+
+  Builder expected_builder(&zone);
+  Scanner expected_scanner(&zone, &expected_builder);
+  expected_scanner.Scan(input, Location());
+  List<TokenInfo> expected = expected_scanner.EncodedTokens();
+
+  for (int threads = 1; threads <= 8; threads++) {
+    Zone scan_zone;
+    Builder builder(&scan_zone);
+    Scanner scanner(&scan_zone, &builder);
+    scanner.ScanParallel(input, Location(), threads);
+    List<TokenInfo> actual = scanner.EncodedTokens();
+    ExpectSameTokens(expected, actual);
+    for (int i = 0; i < expected.length(); i++) {
+      EXPECT_EQ(expected[i].is_continuation(), actual[i].is_continuation());
+    }
+    EXPECT_EQ(expected_builder.Identifiers().length(),
+              builder.Identifiers().length());
+    EXPECT_EQ(expected_builder.Registry().length(),
+              builder.Registry().length());
+    List<Diagnostic> diagnostics = builder.Diagnostics();
+    EXPECT_EQ(expected_builder.error_count(), diagnostics.length());
+    for (int i = 0; i < diagnostics.length(); i++) {
+      EXPECT_EQ(expected_builder.Diagnostics()[i].location.raw(),
+                diagnostics[i].location.raw());
+    }
+    EXPECT_EQ(expected_builder.string_count(), builder.string_count());
+    for (int i = 0; i < builder.string_count(); i++) {
+      EXPECT(expected_builder.LookupString(i)->value().Equals(
+          builder.LookupString(i)->value()));
+    }
+  }
+}
+
+TEST_CASE(ScannerSpeed) {
+  Zone zone;
+  const int REPEAT = 5;
+  StringBuffer buffer(&zone);
+  for (int i = 0; i < 4000; i++) {
+    buffer.Print(
+        "  /**\n"
+        "   * Returns the sum of [a] and [b].\n"
+        "   */\n"
+        "  int add%d(int a, int b) {\n"
+        "    // Add them up.\n"
+        "    return a + b * %d;\n"
+        "  }\n"
+        "\n",
+        i, i);
+  }
+  const char* input = buffer.ToString();
+  size_t length = strlen(input);
+  i64 start = OS::CurrentTime();
+  for (int i = 0; i < REPEAT; i++) {
+    Zone scan_zone;
+    Builder builder(&scan_zone);
+    Scanner scanner(&scan_zone, &builder);
+    scanner.Scan(input, Location());
+    EXPECT_EQ(4000 * 18 + 1, scanner.EncodedTokens().length());
+  }
+  i64 elapsed = OS::CurrentTime() - start;
+  if (elapsed <= 0) elapsed = 1;
+  printf("ScannerSpeed: %.1f MB/s\n",
+         static_cast<double>(length) * REPEAT / elapsed);
+}
+
+TEST_CASE(RescanSpeed) {
+  Zone zone;
+  const int REPEAT = 5;
+  StringBuffer buffer(&zone);
+  for (int i = 0; i < 4000; i++) {
+    buffer.Print("  int add%d(int a, int b) {\n    return a + b * %d;\n  }\n",
+                 i, i);
+  }
+  const char* input = buffer.ToString();
+  Builder builder(&zone);
+  Scanner scanner(&zone, &builder);
+  scanner.Scan(input, Location());
+  List<TokenInfo> tokens = scanner.EncodedTokens();
+
+  // Insert a character in the middle of the input.
+  const char* middle = strstr(input + strlen(input) / 2, "return");
+  int offset = middle - input;
+  int length = strlen(input);
+  char* edited = static_cast<char*>(zone.Allocate(length + 2));
+  memcpy(edited, input, offset);
+  edited[offset] = 'x';
+  strcpy(edited + offset + 1, middle);
+
+  i64 full = 0;
+  i64 incremental = 0;
+  for (int i = 0; i < REPEAT; i++) {
+    Zone scan_zone;
+    i64 start = OS::CurrentTime();
+    Scanner full_scanner(&scan_zone, &builder);
+    full_scanner.Scan(edited, Location());
+    EXPECT_EQ(tokens.length(), full_scanner.EncodedTokens().length());
+    i64 elapsed = OS::CurrentTime() - start;
+    if (i == 0 || elapsed < full) full = elapsed;
+
+    start = OS::CurrentTime();
+    Scanner rescanner(&scan_zone, &builder);
+    rescanner.Rescan(tokens, edited, Location(), offset, 0, 1);
+    EXPECT_EQ(tokens.length(), rescanner.EncodedTokens().length());
+    elapsed = OS::CurrentTime() - start;
+    if (i == 0 || elapsed < incremental) incremental = elapsed;
+  }
+  printf("RescanSpeed: full scan %d us, rescan %d us\n",
+         static_cast<int>(full), static_cast<int>(incremental));
+}
+
+TEST_CASE(ParallelScanSpeed) {
+  Zone zone;
+  const int REPEAT = 3;
+  const int THREADS = 4;
+  StringBuffer buffer(&zone);
+  for (int i = 0; i < 40000; i++) {
+    buffer.Print("  int add%d(int a, int b) {\n    return a + b * %d;\n  }\n",
+                 i, i);
+  }
+  const char* input = buffer.ToString();
+  size_t length = strlen(input);
+  i64 sequential = 0;
+  i64 parallel = 0;
+  for (int i = 0; i < REPEAT; i++) {
+    Zone scan_zone;
+    Builder builder(&scan_zone);
+    i64 start = OS::CurrentTime();
+    Scanner scanner(&scan_zone, &builder);
+    scanner.Scan(input, Location());
+    i64 elapsed = OS::CurrentTime() - start;
+    if (i == 0 || elapsed < sequential) sequential = elapsed;
+
+    Zone parallel_zone;
+    Builder parallel_builder(&parallel_zone);
+    start = OS::CurrentTime();
+    Scanner parallel_scanner(&parallel_zone, &parallel_builder);
+    parallel_scanner.ScanParallel(input, Location(), THREADS);
+    elapsed = OS::CurrentTime() - start;
+    if (i == 0 || elapsed < parallel) parallel = elapsed;
+  }
+  if (sequential <= 0) sequential = 1;
+  if (parallel <= 0) parallel = 1;
+  printf("ParallelScanSpeed: 1 thread %.1f MB/s, %d threads %.1f MB/s\n",
+         static_cast<double>(length) / sequential, THREADS,
+         static_cast<double>(length) / parallel);
+}
+
+static void ScanTokenKindSpeed(const char* kind, const char* fragment) {
+  Zone zone;
+  const int REPEAT = 5;
+  StringBuffer buffer(&zone);
+  for (int i = 0; i < 20000; i++) buffer.Print("%s", fragment);
+  const char* input = buffer.ToString();
+  size_t length = strlen(input);
+  // Report the fastest run to reduce the noise from other processes.
+  i64 best = 0;
+  for (int i = 0; i < REPEAT; i++) {
+    i64 start = OS::CurrentTime();
+    Zone scan_zone;
+    Builder builder(&scan_zone);
+    Scanner scanner(&scan_zone, &builder);
+    scanner.Scan(input, Location());
+    i64 elapsed = OS::CurrentTime() - start;
+    if (i == 0 || elapsed < best) best = elapsed;
+  }
+  if (best <= 0) best = 1;
+  printf("ScannerSpeed %s: %.1f MB/s\n",
+         kind, static_cast<double>(length) / best);
+}
+
+TEST_CASE(ScannerTokenKindSpeed) {
+  ScanTokenKindSpeed("identifiers", "fooBar baz_42 $qux ");
+  ScanTokenKindSpeed("keywords", "class return extends abstract ");
+  ScanTokenKindSpeed("integers", "12345 0x7f 9 ");
+  ScanTokenKindSpeed("doubles", "3.14159 1e10 .5 ");
+  ScanTokenKindSpeed("strings", "'hello world' \"a \\n b\" ");
+  ScanTokenKindSpeed("long strings",
+                     "'The quick brown fox jumps over the lazy dog, "
+                     "and then it does it again.' \"\"\"\n"
+                     "  A multiline template with a $hole in it.\n\"\"\" ");
+  ScanTokenKindSpeed("punctuation", "( ) [ ] { } ++ >= == => ; ");
+  ScanTokenKindSpeed("comments", "// line\n/* block */ ");
+}
+
 }  // namespace rart
@@ -0,0 +1,261 @@
+// Copyright (c) 2015, the Rart project authors. Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE.md file.
+
+#ifndef SRC_SIMD_H_
+#define SRC_SIMD_H_
+
+#include "src/globals.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace rart {
+
+// Helpers for finding the next interesting byte in a zero-terminated
+// buffer. Every search stops at the terminating zero at the latest.
+//
+// The vectorized versions classify 16 bytes at a time. They only use
+// aligned loads, and an aligned 16-byte block never straddles a page
+// boundary, so reading the rest of the block that holds the terminating
+// zero is safe even though it may be past the end of the buffer.
+class Simd {
+ public:
+  // Returns the first byte at or after p that is not ' ', '\t', '\n'
+  // or '\r'.
+  static inline const char* SkipWhitespace(const char* p);
+
+  // Returns the first '\n', '\r' or '\0' at or after p.
+  static inline const char* FindNewline(const char* p);
+
+  // Returns the first '*', '/' or '\0' at or after p.
+  static inline const char* FindCommentDelimiter(const char* p);
+
+  // Returns the first quote, '\\', '$' or '\0' at or after p. The quote
+  // is either ' or ".
+  static inline const char* FindStringDelimiter(const char* p, char quote);
+
+  // Returns the first byte in [p, end) that is not ASCII, or end. Unlike
+  // the searches above, this one does not need a terminating zero.
+  static inline const char* FindNonAscii(const char* p, const char* end);
+
+  // Returns the first '\n' or '\r' in [p, end), or end. Like FindNonAscii,
+  // this doesn't need a terminating zero and doesn't read past end.
+  static inline const char* FindNewline(const char* p, const char* end);
+
+  // Byte-at-a-time versions of the above. These are used on hosts
+  // without SSE2, and for testing and benchmarking the vector versions.
+  static inline const char* SkipWhitespaceScalar(const char* p);
+  static inline const char* FindNewlineScalar(const char* p);
+  static inline const char* FindCommentDelimiterScalar(const char* p);
+  static inline const char* FindStringDelimiterScalar(const char* p,
+                                                      char quote);
+  static inline const char* FindNonAsciiScalar(const char* p,
+                                               const char* end);
+  static inline const char* FindNewlineScalar(const char* p,
+                                              const char* end);
+
+#if defined(__SSE2__)
+  static const bool kIsVectorized = true;
+
+ private:
+  static const int kBlockSize = 16;
+
+  // Runs the block matcher over the blocks starting at the block that
+  // holds p, and returns the first matching byte at or after p. The
+  // matcher must match the zero byte.
+  //
+  // The last block may extend past the terminating zero, and so past the
+  // end of the buffer. The overread is deliberate and harmless, because an
+  // aligned block never crosses into the next page. AddressSanitizer would
+  // still report it, so this function is not instrumented.
+  template<typename Matcher>
+  __attribute__((no_sanitize_address))
+  static inline const char* Find(const char* p, Matcher matcher) {
+    uword address = reinterpret_cast<uword>(p);
+    uword aligned = address & ~static_cast<uword>(kBlockSize - 1);
+    const __m128i* block = reinterpret_cast<const __m128i*>(aligned);
+    // Ignore the matches before p in the first block.
+    int skip = static_cast<int>(address - aligned);
+    u32 mask = (matcher.Match(_mm_load_si128(block)) >> skip) << skip;
+    while (mask == 0) {
+      mask = matcher.Match(_mm_load_si128(++block));
+    }
+    return reinterpret_cast<const char*>(block) + __builtin_ctz(mask);
+  }
+
+  static inline __m128i Splat(char c) { return _mm_set1_epi8(c); }
+
+  struct NonWhitespace {
+    static inline u32 Match(__m128i bytes) {
+      __m128i ws = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(bytes, Splat(' ')),
+                       _mm_cmpeq_epi8(bytes, Splat('\t'))),
+          _mm_or_si128(_mm_cmpeq_epi8(bytes, Splat('\n')),
+                       _mm_cmpeq_epi8(bytes, Splat('\r'))));
+      return ~static_cast<u32>(_mm_movemask_epi8(ws)) & 0xFFFF;
+    }
+  };
+
+  struct Newline {
+    static inline u32 Match(__m128i bytes) {
+      __m128i hits = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(bytes, Splat('\n')),
+                       _mm_cmpeq_epi8(bytes, Splat('\r'))),
+          _mm_cmpeq_epi8(bytes, _mm_setzero_si128()));
+      return _mm_movemask_epi8(hits);
+    }
+  };
+
+  struct LineBreak {
+    static inline u32 Match(__m128i bytes) {
+      __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(bytes, Splat('\n')),
+                                  _mm_cmpeq_epi8(bytes, Splat('\r')));
+      return _mm_movemask_epi8(hits);
+    }
+  };
+
+  struct CommentDelimiter {
+    static inline u32 Match(__m128i bytes) {
+      __m128i hits = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(bytes, Splat('*')),
+                       _mm_cmpeq_epi8(bytes, Splat('/'))),
+          _mm_cmpeq_epi8(bytes, _mm_setzero_si128()));
+      return _mm_movemask_epi8(hits);
+    }
+  };
+
+  // Unlike the matchers above, this one depends on the quote, so it
+  // is passed by value and keeps the splatted quote in a register.
+  struct StringDelimiter {
+    explicit StringDelimiter(char quote) : quote(Splat(quote)) { }
+
+    inline u32 Match(__m128i bytes) const {
+      __m128i hits = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(bytes, quote),
+                       _mm_cmpeq_epi8(bytes, Splat('\\'))),
+          _mm_or_si128(_mm_cmpeq_epi8(bytes, Splat('$')),
+                       _mm_cmpeq_epi8(bytes, _mm_setzero_si128())));
+      return _mm_movemask_epi8(hits);
+    }
+
+    const __m128i quote;
+  };
+#else
+  static const bool kIsVectorized = false;
+#endif
+};
+
+const char* Simd::SkipWhitespaceScalar(const char* p) {
+  while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+  return p;
+}
+
+const char* Simd::FindNewlineScalar(const char* p) {
+  while (*p != '\n' && *p != '\r' && *p != '\0') p++;
+  return p;
+}
+
+const char* Simd::FindCommentDelimiterScalar(const char* p) {
+  while (*p != '*' && *p != '/' && *p != '\0') p++;
+  return p;
+}
+
+const char* Simd::FindStringDelimiterScalar(const char* p, char quote) {
+  while (*p != quote && *p != '\\' && *p != '$' && *p != '\0') p++;
+  return p;
+}
+
+const char* Simd::FindNonAsciiScalar(const char* p, const char* end) {
+  while (p < end && static_cast<u8>(*p) < 0x80) p++;
+  return p;
+}
+
+const char* Simd::FindNewlineScalar(const char* p, const char* end) {
+  while (p < end && *p != '\n' && *p != '\r') p++;
+  return p;
+}
+
+#if defined(__SSE2__)
+
+const char* Simd::SkipWhitespace(const char* p) {
+  return Find(p, NonWhitespace());
+}
+
+const char* Simd::FindNewline(const char* p) {
+  return Find(p, Newline());
+}
+
+const char* Simd::FindCommentDelimiter(const char* p) {
+  return Find(p, CommentDelimiter());
+}
+
+const char* Simd::FindStringDelimiter(const char* p, char quote) {
+  return Find(p, StringDelimiter(quote));
+}
+
+const char* Simd::FindNonAscii(const char* p, const char* end) {
+  // The high bit of every byte is the sign bit, so one movemask tells
+  // whether a block is all ASCII. Check four blocks at a time while the
+  // input is ASCII.
+  const __m128i* block = reinterpret_cast<const __m128i*>(p);
+  while (end - p >= 4 * kBlockSize) {
+    __m128i bytes = _mm_or_si128(
+        _mm_or_si128(_mm_loadu_si128(block), _mm_loadu_si128(block + 1)),
+        _mm_or_si128(_mm_loadu_si128(block + 2), _mm_loadu_si128(block + 3)));
+    if (_mm_movemask_epi8(bytes) != 0) break;
+    block += 4;
+    p += 4 * kBlockSize;
+  }
+  while (end - p >= kBlockSize) {
+    u32 mask = _mm_movemask_epi8(_mm_loadu_si128(block));
+    if (mask != 0) return p + __builtin_ctz(mask);
+    block++;
+    p += kBlockSize;
+  }
+  return FindNonAsciiScalar(p, end);
+}
+
+const char* Simd::FindNewline(const char* p, const char* end) {
+  const __m128i* block = reinterpret_cast<const __m128i*>(p);
+  while (end - p >= kBlockSize) {
+    u32 mask = LineBreak::Match(_mm_loadu_si128(block));
+    if (mask != 0) return p + __builtin_ctz(mask);
+    block++;
+    p += kBlockSize;
+  }
+  return FindNewlineScalar(p, end);
+}
+
+#else
+
+const char* Simd::SkipWhitespace(const char* p) {
+  return SkipWhitespaceScalar(p);
+}
+
+const char* Simd::FindNewline(const char* p) {
+  return FindNewlineScalar(p);
+}
+
+const char* Simd::FindCommentDelimiter(const char* p) {
+  return FindCommentDelimiterScalar(p);
+}
+
+const char* Simd::FindStringDelimiter(const char* p, char quote) {
+  return FindStringDelimiterScalar(p, quote);
+}
+
+const char* Simd::FindNonAscii(const char* p, const char* end) {
+  return FindNonAsciiScalar(p, end);
+}
+
+const char* Simd::FindNewline(const char* p, const char* end) {
+  return FindNewlineScalar(p, end);
+}
+
+#endif
+
+}  // namespace rart
+
+#endif  // SRC_SIMD_H_
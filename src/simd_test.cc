@@ -0,0 +1,135 @@
+// Copyright (c) 2015, the Rart project authors. Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE.md file.
+
+#define TESTING
+
+#include <stdio.h>
+#include <string.h>
+
+#include "src/assert.h"
+#include "src/os.h"
+#include "src/simd.h"
+#include "src/test_case.h"
+#include "src/zone.h"
+
+namespace rart {
+
+TEST_CASE(SimdSkipWhitespace) {
+  // Try all alignments of the start and of the first interesting byte.
+  char buffer[80];
+  for (int start = 0; start < 16; start++) {
+    for (int length = 0; length < 40; length++) {
+      memset(buffer, 0, sizeof(buffer));
+      for (int i = 0; i < length; i++) buffer[start + i] = " \t\n\r"[i % 4];
+      const char* p = buffer + start;
+      EXPECT_EQ(p + length, Simd::SkipWhitespace(p));
+      EXPECT_EQ(p + length, Simd::SkipWhitespaceScalar(p));
+      buffer[start + length] = 'x';
+      EXPECT_EQ(p + length, Simd::SkipWhitespace(p));
+    }
+  }
+}
+
+TEST_CASE(SimdFindNewline) {
+  char buffer[80];
+  for (int start = 0; start < 16; start++) {
+    for (int length = 0; length < 40; length++) {
+      memset(buffer, 'a', sizeof(buffer));
+      buffer[sizeof(buffer) - 1] = 0;
+      // Interesting bytes before the start must be ignored.
+      if (start > 0) buffer[start - 1] = '\n';
+      const char* p = buffer + start;
+      buffer[start + length] = '\r';
+      EXPECT_EQ(p + length, Simd::FindNewline(p));
+      buffer[start + length] = '\n';
+      EXPECT_EQ(p + length, Simd::FindNewline(p));
+      EXPECT_EQ(p + length, Simd::FindNewlineScalar(p));
+      buffer[start + length] = 0;
+      EXPECT_EQ(p + length, Simd::FindNewline(p));
+      // The bounded search ignores zeros and stops at the end.
+      EXPECT_EQ(p + length, Simd::FindNewline(p, p + length));
+      EXPECT_EQ(p + length, Simd::FindNewlineScalar(p, p + length));
+      buffer[start + length] = '\r';
+      EXPECT_EQ(p + length, Simd::FindNewline(p, buffer + sizeof(buffer)));
+      if (length > 0) buffer[start] = 0;
+      EXPECT_EQ(p + length, Simd::FindNewline(p, buffer + sizeof(buffer)));
+    }
+  }
+}
+
+TEST_CASE(SimdFindCommentDelimiter) {
+  char buffer[80];
+  for (int start = 0; start < 16; start++) {
+    for (int length = 0; length < 40; length++) {
+      memset(buffer, '\n', sizeof(buffer));
+      buffer[sizeof(buffer) - 1] = 0;
+      if (start > 0) buffer[start - 1] = '*';
+      const char* p = buffer + start;
+      buffer[start + length] = '*';
+      EXPECT_EQ(p + length, Simd::FindCommentDelimiter(p));
+      buffer[start + length] = '/';
+      EXPECT_EQ(p + length, Simd::FindCommentDelimiter(p));
+      EXPECT_EQ(p + length, Simd::FindCommentDelimiterScalar(p));
+      buffer[start + length] = 0;
+      EXPECT_EQ(p + length, Simd::FindCommentDelimiter(p));
+    }
+  }
+}
+
+TEST_CASE(SimdFindStringDelimiter) {
+  char buffer[80];
+  for (int start = 0; start < 16; start++) {
+    for (int length = 0; length < 40; length++) {
+      memset(buffer, 'a', sizeof(buffer));
+      buffer[sizeof(buffer) - 1] = 0;
+      if (start > 0) buffer[start - 1] = '$';
+      const char* p = buffer + start;
+      // The other quote and newlines don't end the search.
+      buffer[start + length] = '"';
+      if (length > 0) buffer[start + length - 1] = '\n';
+      EXPECT_EQ(p + length, Simd::FindStringDelimiter(p, '"'));
+      EXPECT_EQ(p + length, Simd::FindStringDelimiterScalar(p, '"'));
+      buffer[start + length] = '\'';
+      EXPECT_EQ(p + length, Simd::FindStringDelimiter(p, '\''));
+      EXPECT_EQ(buffer + sizeof(buffer) - 1,
+                Simd::FindStringDelimiter(p, '"'));
+      buffer[start + length] = '\\';
+      EXPECT_EQ(p + length, Simd::FindStringDelimiter(p, '"'));
+      buffer[start + length] = '$';
+      EXPECT_EQ(p + length, Simd::FindStringDelimiter(p, '\''));
+      buffer[start + length] = 0;
+      EXPECT_EQ(p + length, Simd::FindStringDelimiter(p, '\''));
+    }
+  }
+}
+
+TEST_CASE(SimdSpeedTest) {
+  Zone zone;
+  const int SIZE = 1 << 20;
+  const int REPEAT = 10;
+  char* buffer = static_cast<char*>(zone.Allocate(SIZE + 1));
+  memset(buffer, ' ', SIZE);
+  buffer[SIZE] = 0;
+
+  i64 start = OS::CurrentTime();
+  for (int i = 0; i < REPEAT; i++) {
+    EXPECT_EQ(buffer + SIZE, Simd::SkipWhitespaceScalar(buffer));
+  }
+  i64 scalar = OS::CurrentTime() - start;
+
+  start = OS::CurrentTime();
+  for (int i = 0; i < REPEAT; i++) {
+    EXPECT_EQ(buffer + SIZE, Simd::SkipWhitespace(buffer));
+  }
+  i64 vector = OS::CurrentTime() - start;
+
+  if (scalar <= 0) scalar = 1;
+  if (vector <= 0) vector = 1;
+  printf("SimdSpeedTest: scalar %.1f MB/s, %s %.1f MB/s\n",
+         static_cast<double>(SIZE) * REPEAT / scalar,
+         Simd::kIsVectorized ? "sse2" : "fallback",
+         static_cast<double>(SIZE) * REPEAT / vector);
+}
+
+}  // namespace rart
@@ -9,11 +9,14 @@
 #include "src/os.h"
 #include "src/builder.h"
 #include "src/parser.h"
+#include "src/simd.h"
+#include "src/utf8.h"
+#include "src/utils.h"
 
 namespace rart {
 
 Source::Source(Zone* zone)
-    : chunks_(zone) {
+    : zone_(zone) {
 }
 
 Location Source::LoadFile(const char* path) {
@@ -26,50 +29,123 @@ Location Source::LoadFile(const char* path) {
 Location Source::LoadFromBuffer(const char* path,
                                 const char* source,
                                 u32 size) {
-  Location location(chunks_.length() * kChunkSize);
+  Location location(chunks_length_ * kChunkSize);
+  File* file = new(zone_) File();
+  file->path = path;
+  file->start = source;
+  file->size = size;
+  file->invalid_utf8 = Utf8::Validate(source, size);
+  file->line_starts = ComputeLineStarts(zone_, source, size);
   for (u32 i = 0; i < size; i += kChunkSize) {
     Chunk chunk;
-    chunk.file_path = path;
-    chunk.file_start = source;
+    chunk.file = file;
     chunk.chunk_offset = i;
-    chunks_.Add(chunk);
+    AddChunk(chunk);
   }
   return location;
 }
 
 const char* Source::GetSource(Location location) {
   if (location.IsInvalid()) return "<Invalid location>";
-  u32 index = location.raw() >> kChunkBits;
-  Chunk chunk = chunks_.Get(index);
-  return chunk.file_start +
-      chunk.chunk_offset +
-      (location.raw() & (kChunkSize - 1));
+  u32 offset;
+  File* file = GetFile(location, &offset);
+  return file->start + offset;
 }
 
 const char* Source::GetFilePath(Location location) {
   if (location.IsInvalid()) return "<Invalid location>";
-  u32 index = location.raw() >> kChunkBits;
-  Chunk chunk = chunks_.Get(index);
-  return chunk.file_path;
+  u32 offset;
+  return GetFile(location, &offset)->path;
 }
 
 const char* Source::GetLine(Location location, int* line_length) {
   if (location.IsInvalid()) return "<Invalid location>";
-  // TODO(ajohnsen): Cache this.
+  u32 offset;
+  File* file = GetFile(location, &offset);
+  int line = FindLine(file, offset);
+  u32 start = file->line_starts[line];
+  u32 end = (line + 1 < file->line_starts.length())
+      ? file->line_starts[line + 1]
+      : file->size;
+  // Leave out the line terminator.
+  if (end > start && file->start[end - 1] == '\n') end--;
+  if (end > start && file->start[end - 1] == '\r') end--;
+  if (line_length != NULL) *line_length = end - start;
+  return file->start + start;
+}
+
+void Source::GetLineAndColumn(Location location, int* line, int* column) {
+  ASSERT(!location.IsInvalid());
+  u32 offset;
+  File* file = GetFile(location, &offset);
+  int index = FindLine(file, offset);
+  *line = index + 1;
+  *column = offset - file->line_starts[index] + 1;
+}
+
+Location Source::FindInvalidUtf8(Location location) {
+  if (location.IsInvalid()) return Location();
   u32 index = location.raw() >> kChunkBits;
-  Chunk chunk = chunks_.Get(index);
-  const char* pos = chunk.file_start + chunk.chunk_offset;
-  pos += location.raw() & (kChunkSize - 1);
-  const char* start = pos;
-  while (start > chunk.file_start && start[-1] != '\n' && start[-1] != '\r') {
-    start--;
+  if (index >= static_cast<u32>(chunks_length_)) return Location();
+  Chunk chunk = chunks_[index];
+  if (chunk.file->invalid_utf8 < 0) return Location();
+  u32 file_index = index - (chunk.chunk_offset >> kChunkBits);
+  return Location((file_index << kChunkBits) + chunk.file->invalid_utf8);
+}
+
+Source::File* Source::GetFile(Location location, u32* offset) {
+  u32 raw = location.raw();
+  ASSERT((raw >> kChunkBits) < static_cast<u32>(chunks_length_));
+  Chunk chunk = chunks_[raw >> kChunkBits];
+  *offset = chunk.chunk_offset + (raw & (kChunkSize - 1));
+  return chunk.file;
+}
+
+void Source::AddChunk(Chunk chunk) {
+  if (chunks_length_ == chunks_capacity_) {
+    int capacity = Utils::Maximum(16, chunks_capacity_ * 2);
+    Chunk* chunks = static_cast<Chunk*>(
+        zone_->Allocate(capacity * sizeof(Chunk)));
+    if (chunks_length_ > 0) {
+      memcpy(chunks, chunks_, chunks_length_ * sizeof(Chunk));
+    }
+    chunks_ = chunks;
+    chunks_capacity_ = capacity;
+  }
+  chunks_[chunks_length_++] = chunk;
+}
+
+int Source::FindLine(File* file, u32 offset) {
+  // Find the last line that starts at or before offset. The first line
+  // always starts at offset zero.
+  const List<u32>& starts = file->line_starts;
+  int low = 0;
+  int high = starts.length();
+  while (high - low > 1) {
+    int middle = low + (high - low) / 2;
+    if (starts[middle] <= offset) {
+      low = middle;
+    } else {
+      high = middle;
+    }
   }
-  const char* end = pos;
-  while (end[0] != 0 && end[0] != '\n' && end[0] != '\r') {
-    end++;
+  return low;
+}
+
+List<u32> Source::ComputeLineStarts(Zone* zone, const char* source,
+                                    u32 size) {
+  // The buffer need not be zero-terminated, so the search is bounded.
+  Zone temporary;
+  ListBuilder<u32, 256> starts(&temporary);
+  starts.Add(0);
+  const char* end = source + size;
+  const char* p = Simd::FindNewline(source, end);
+  while (p < end) {
+    if (p[0] == '\r' && p + 1 < end && p[1] == '\n') p++;
+    starts.Add(p + 1 - source);
+    p = Simd::FindNewline(p + 1, end);
   }
-  if (line_length != NULL) *line_length = end - start;
-  return start;
+  return starts.ToList(zone);
 }
 
 }  // namespace rart
@@ -5,7 +5,7 @@
 #ifndef SRC_SOURCE_H_
 #define SRC_SOURCE_H_
 
-#include "src/list_builder.h"
+#include "src/list.h"
 #include "src/zone.h"
 
 namespace rart {
@@ -48,15 +48,53 @@ class Source : public StackAllocated {
   const char* GetFilePath(Location location);
   const char* GetLine(Location location, int* line_length);
 
+  // Computes the 1-based line and column of the location. Columns count
+  // bytes. The lookup is a binary search in a table of line starts that
+  // is built when the file is loaded.
+  void GetLineAndColumn(Location location, int* line, int* column);
+
+  // Returns the location of the first malformed UTF-8 sequence in the
+  // file containing the given location, or an invalid location if the
+  // file is well-formed. Files are validated once, when they are loaded.
+  Location FindInvalidUtf8(Location location);
+
  private:
+  class File : public ZoneAllocated {
+   public:
+    const char* path;
+    const char* start;
+    u32 size;
+    // Offset of the first malformed UTF-8 sequence, or -1.
+    int invalid_utf8;
+    // Offset of the first byte of each line, in increasing order. A line
+    // ends with '\n', '\r' or "\r\n".
+    List<u32> line_starts;
+  };
+
   class Chunk {
    public:
-    const char* file_path;
-    const char* file_start;
+    File* file;
     u32 chunk_offset;
   };
 
-  ListBuilder<Chunk, 8> chunks_;
+  // Returns the file containing the location and the offset of the
+  // location in that file.
+  File* GetFile(Location location, u32* offset);
+
+  // Returns the index in file->line_starts of the line containing offset.
+  static int FindLine(File* file, u32 offset);
+
+  static List<u32> ComputeLineStarts(Zone* zone, const char* source,
+                                     u32 size);
+
+  void AddChunk(Chunk chunk);
+
+  Zone* const zone_;
+  // Every location lookup finds its chunk, so the chunks are kept in a
+  // flat array that grows by doubling.
+  Chunk* chunks_ = NULL;
+  int chunks_length_ = 0;
+  int chunks_capacity_ = 0;
 };
 
 }  // namespace rart
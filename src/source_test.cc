@@ -0,0 +1,116 @@
+// Copyright (c) 2015, the Rart project authors. Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE.md file.
+
+#define TESTING
+
+#include <stdio.h>
+#include <string.h>
+
+#include "src/assert.h"
+#include "src/os.h"
+#include "src/source.h"
+#include "src/test_case.h"
+#include "src/zone.h"
+
+namespace rart {
+
+static void ExpectLineAndColumn(Source* source,
+                                Location location,
+                                int expected_line,
+                                int expected_column) {
+  int line = 0;
+  int column = 0;
+  source->GetLineAndColumn(location, &line, &column);
+  EXPECT_EQ(expected_line, line);
+  EXPECT_EQ(expected_column, column);
+}
+
+static void ExpectLine(Source* source,
+                       Location location,
+                       const char* expected) {
+  int length = -1;
+  const char* line = source->GetLine(location, &length);
+  EXPECT_EQ(static_cast<int>(strlen(expected)), length);
+  EXPECT(strncmp(expected, line, length) == 0);
+}
+
+TEST_CASE(SourceLineAndColumn) {
+  Zone zone;
+  Source source(&zone);
+  const char* text = "ab\ncd\r\nef\rg\n\nh";
+  Location start = source.LoadFromBuffer("<test>", text, strlen(text));
+  ExpectLineAndColumn(&source, start, 1, 1);
+  ExpectLineAndColumn(&source, start + 1, 1, 2);
+  // The line terminator belongs to the line it ends.
+  ExpectLineAndColumn(&source, start + 2, 1, 3);
+  ExpectLineAndColumn(&source, start + 3, 2, 1);
+  ExpectLineAndColumn(&source, start + 5, 2, 3);
+  ExpectLineAndColumn(&source, start + 6, 2, 4);
+  ExpectLineAndColumn(&source, start + 7, 3, 1);
+  ExpectLineAndColumn(&source, start + 10, 4, 1);
+  ExpectLineAndColumn(&source, start + 12, 5, 1);
+  ExpectLineAndColumn(&source, start + 13, 6, 1);
+
+  ExpectLine(&source, start + 1, "ab");
+  ExpectLine(&source, start + 6, "cd");
+  ExpectLine(&source, start + 8, "ef");
+  ExpectLine(&source, start + 10, "g");
+  ExpectLine(&source, start + 12, "");
+  ExpectLine(&source, start + 13, "h");
+}
+
+TEST_CASE(SourceMultipleFiles) {
+  Zone zone;
+  Source source(&zone);
+  // The first file spans several chunks.
+  const int SIZE = 10000;
+  char* first = static_cast<char*>(zone.Allocate(SIZE + 1));
+  for (int i = 0; i < SIZE; i++) first[i] = (i % 10 == 9) ? '\n' : 'x';
+  first[SIZE] = 0;
+  Location one = source.LoadFromBuffer("<one>", first, SIZE);
+  Location two = source.LoadFromBuffer("<two>", "a\nb", 3);
+  ExpectLineAndColumn(&source, one + 5003, 501, 4);
+  ExpectLineAndColumn(&source, one + (SIZE - 1), SIZE / 10, 10);
+  ExpectLineAndColumn(&source, two, 1, 1);
+  ExpectLineAndColumn(&source, two + 2, 2, 1);
+  ExpectLine(&source, one + 5003, "xxxxxxxxx");
+  EXPECT_STREQ("<two>", source.GetFilePath(two + 2));
+}
+
+TEST_CASE(SourceLineSpeed) {
+  Zone zone;
+  Source source(&zone);
+  const int LINES = 100000;
+  const int LINE_LENGTH = 40;
+  const int SIZE = LINES * LINE_LENGTH;
+  char* text = static_cast<char*>(zone.Allocate(SIZE + 1));
+  for (int i = 0; i < SIZE; i++) {
+    text[i] = (i % LINE_LENGTH == LINE_LENGTH - 1) ? '\n' : 'x';
+  }
+  text[SIZE] = 0;
+
+  i64 start = OS::CurrentTime();
+  Location location = source.LoadFromBuffer("<speed>", text, SIZE);
+  i64 load = OS::CurrentTime() - start;
+
+  const int LOOKUPS = 100000;
+  start = OS::CurrentTime();
+  for (int i = 0; i < LOOKUPS; i++) {
+    u32 offset = (i * 7919u) % SIZE;
+    int line = 0;
+    int column = 0;
+    source.GetLineAndColumn(location + offset, &line, &column);
+    EXPECT_EQ(static_cast<int>(offset / LINE_LENGTH) + 1, line);
+    EXPECT_EQ(static_cast<int>(offset % LINE_LENGTH) + 1, column);
+  }
+  i64 lookups = OS::CurrentTime() - start;
+
+  if (load <= 0) load = 1;
+  if (lookups <= 0) lookups = 1;
+  printf("SourceLineSpeed: load %.1f MB/s, %.0f lookups/s\n",
+         static_cast<double>(SIZE) / load,
+         static_cast<double>(LOOKUPS) * 1000000 / lookups);
+}
+
+}  // namespace rart
@@ -33,6 +33,10 @@ void StringBuffer::VPrint(const char *format, va_list arguments) {
   for (int i = 0; i < written; i++) builder_.Add(buffer[i]);
 }
 
+void StringBuffer::Append(StringSlice slice) {
+  for (int i = 0; i < slice.length(); i++) builder_.Add(slice.data()[i]);
+}
+
 void StringBuffer::Clear() {
   builder_.Clear();
 }
@@ -8,6 +8,7 @@
 #include <cstdarg>
 
 #include "src/list_builder.h"
+#include "src/string_slice.h"
 
 namespace rart {
 
@@ -18,6 +19,7 @@ class StringBuffer : public StackAllocated {
   const char* ToString();
   void Print(const char* format, ...);
   void VPrint(const char *format, va_list arguments);
+  void Append(StringSlice slice);
 
   void Clear();
 
@@ -0,0 +1,60 @@
+// Copyright (c) 2015, the Rart project authors. Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE.md file.
+
+#ifndef SRC_STRING_SLICE_H_
+#define SRC_STRING_SLICE_H_
+
+#include <string.h>
+
+#include "src/assert.h"
+#include "src/zone.h"
+
+namespace rart {
+
+// A string given by a pointer and a length. Slices do not own their
+// characters and are not zero-terminated; most of them point straight
+// into a source buffer. Print them with "%.*s".
+class StringSlice {
+ public:
+  StringSlice() : data_(NULL), length_(0) {
+  }
+
+  StringSlice(const char* data, int length) : data_(data), length_(length) {
+    ASSERT(length >= 0);
+  }
+
+  // Makes a slice of a zero-terminated string.
+  explicit StringSlice(const char* string)
+      : data_(string), length_(strlen(string)) {
+  }
+
+  const char* data() const { return data_; }
+  int length() const { return length_; }
+  bool is_empty() const { return length_ == 0; }
+
+  bool Equals(StringSlice other) const {
+    return length_ == other.length_ &&
+        memcmp(data_, other.data_, length_) == 0;
+  }
+
+  bool Equals(const char* string) const {
+    return Equals(StringSlice(string));
+  }
+
+  // Returns a zero-terminated copy allocated in the zone.
+  const char* ToCString(Zone* zone) const {
+    char* result = static_cast<char*>(zone->Allocate(length_ + 1));
+    memcpy(result, data_, length_);
+    result[length_] = 0;
+    return result;
+  }
+
+ private:
+  const char* data_;
+  int length_;
+};
+
+}  // namespace rart
+
+#endif  // SRC_STRING_SLICE_H_
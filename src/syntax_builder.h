@@ -0,0 +1,69 @@
+// Copyright (c) 2015, the Rart project authors. Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE.md file.
+
+#ifndef SRC_SYNTAX_BUILDER_H_
+#define SRC_SYNTAX_BUILDER_H_
+
+#include <stdarg.h>
+
+#include "src/builder.h"
+#include "src/scanner.h"
+
+namespace rart {
+
+// A builder policy for BasicParser that doesn't build anything, so parsing
+// with it only checks the syntax. The events are empty inline functions
+// that compile away, except for counting them when kCountEvents is set.
+// The terminals were registered by the Builder that scanned the tokens;
+// errors are reported to it too.
+template<bool kCountEvents>
+class SyntaxBuilder : public StackAllocated {
+ public:
+  explicit SyntaxBuilder(Builder* builder) : builder_(builder) {
+    for (int i = 0; i < kNumberOfBuilderEvents; i++) counts_[i] = 0;
+  }
+
+  Zone* zone() const { return builder_->zone(); }
+
+  bool lazy_method_bodies() const { return false; }
+  bool outline() const { return false; }
+
+  int ComputeCanonicalId(StringSlice name) {
+    return builder_->ComputeCanonicalId(name);
+  }
+
+  int node_count() const { return 0; }
+  void TruncateNodes(int count) { }
+
+  void ReportError(Location location, const char* format, va_list args) {
+    builder_->ReportError(location, format, args);
+  }
+#ifdef PARSER_STATISTICS
+  ParserStatistics* statistics() { return builder_->statistics(); }
+#endif
+
+  // How many times the parser sent an event. Always zero if events are
+  // not counted.
+  int count(BuilderEvent event) const { return counts_[event]; }
+
+#define DECLARE(name, parameters) \
+  void Do##name parameters { Count(k##name##Event); }
+BUILDER_EVENT_LIST(DECLARE)
+#undef DECLARE
+
+ private:
+  Builder* const builder_;
+  int counts_[kNumberOfBuilderEvents];
+
+  void Count(BuilderEvent event) {
+    if (kCountEvents) counts_[event]++;
+  }
+};
+
+typedef SyntaxBuilder<false> NullBuilder;
+typedef SyntaxBuilder<true> CountingBuilder;
+
+}  // namespace rart
+
+#endif  // SRC_SYNTAX_BUILDER_H_
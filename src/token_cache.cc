@@ -0,0 +1,419 @@
+// Copyright (c) 2015, the Rart project authors. Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE.md file.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "src/assert.h"
+#include "src/list_builder.h"
+#include "src/os.h"
+#include "src/token_cache.h"
+#include "src/utils.h"
+
+namespace rart {
+
+// The index of a token refers to the entry's own tables of identifiers,
+// strings and literals. The location is an offset from the start of the
+// source.
+struct TokenCache::CachedToken {
+  u32 value;
+  u32 offset;
+};
+
+struct TokenCache::Span {
+  // Set in the offset of a span that refers to the bytes at the end of
+  // the entry rather than to the source.
+  static const u32 kInBytes = 0x80000000;
+
+  u32 offset;
+  u32 length;
+};
+
+struct TokenCache::Literal {
+  u32 is_double;
+  u32 padding;
+  u64 bits;
+};
+
+// An entry is a header followed by the arrays it describes, in this
+// order, and then by the characters of the terminals that can't be
+// found in the source as they are. Everything is 8-byte aligned, so the
+// arrays can be used in place when the entry is mapped.
+struct TokenCache::Header {
+  u32 magic;
+  u32 version;
+  u64 hash;
+  u32 source_length;
+  u32 token_count;
+  u32 identifier_count;
+  u32 string_count;
+  u32 literal_count;
+  u32 byte_count;
+
+  const CachedToken* tokens() const {
+    return reinterpret_cast<const CachedToken*>(this + 1);
+  }
+  const Span* identifiers() const {
+    return reinterpret_cast<const Span*>(tokens() + token_count);
+  }
+  const Span* strings() const { return identifiers() + identifier_count; }
+  const Literal* literals() const {
+    return reinterpret_cast<const Literal*>(strings() + string_count);
+  }
+  const char* bytes() const {
+    return reinterpret_cast<const char*>(literals() + literal_count);
+  }
+
+  u64 ComputeSize() const;
+};
+
+u64 TokenCache::Header::ComputeSize() const {
+  return sizeof(Header) +
+      static_cast<u64>(token_count) * sizeof(CachedToken) +
+      static_cast<u64>(identifier_count) * sizeof(Span) +
+      static_cast<u64>(string_count) * sizeof(Span) +
+      static_cast<u64>(literal_count) * sizeof(Literal) +
+      byte_count;
+}
+
+TokenCache::TokenCache(const char* directory)
+    : directory_(directory) {
+  OS::CreateDirectory(directory);
+}
+
+TokenColumns TokenCache::Scan(Builder* builder, Zone* zone,
+                              const char* source, Location location) {
+  u32 length = strlen(source);
+  u64 hash = Utils::ContentHash(source, length);
+  const char* path = EntryPath(zone, hash, "");
+  const Header* header = Load(path, hash, source, length);
+  if (header != NULL) {
+    hits_++;
+    TokenColumns columns = Adopt(header, builder, zone, source, location);
+    OS::UnmapFile(header, header->ComputeSize());
+    return columns;
+  }
+  misses_++;
+
+  Scanner scanner(zone, builder);
+  int first_string = builder->string_count();
+  int errors = builder->error_count();
+  scanner.Scan(source, location);
+  List<TokenInfo> tokens = scanner.EncodedTokens();
+  // Entries don't hold errors, so a source with errors is scanned every
+  // time to report them.
+  if (builder->error_count() == errors) {
+    Store(path, builder, tokens, first_string, source, length, hash,
+          location);
+  }
+  return TokenColumns::Split(zone, tokens);
+}
+
+const char* TokenCache::EntryPath(Zone* zone, u64 hash, const char* suffix) {
+  const char* format = "%s/%016" PRIx64 ".tokens%s";
+  int length = snprintf(NULL, 0, format, directory_, hash, suffix);
+  char* path = static_cast<char*>(zone->Allocate(length + 1));
+  snprintf(path, length + 1, format, directory_, hash, suffix);
+  return path;
+}
+
+const TokenCache::Header* TokenCache::Load(const char* path, u64 hash,
+                                           const char* source, u32 length) {
+  u32 size = 0;
+  const Header* header = static_cast<const Header*>(OS::MapFile(path, &size));
+  if (header == NULL) return NULL;
+  if (size < sizeof(Header) ||
+      header->magic != kMagic ||
+      header->version != kVersion ||
+      header->hash != hash ||
+      header->source_length != length ||
+      header->ComputeSize() != size ||
+      !IsValid(header, source)) {
+    OS::UnmapFile(header, size);
+    return NULL;
+  }
+  return header;
+}
+
+bool TokenCache::IsValid(const Header* header, const char* source) {
+  u32 length = header->source_length;
+  u32 count = header->token_count;
+  // The parser stops at the EOF token.
+  if (count == 0) return false;
+  const CachedToken* tokens = header->tokens();
+  for (u32 i = 0; i < count; i++) {
+    TokenInfo info(tokens[i].value, Location());
+    Token token = info.token();
+    if (token > kGT_START || tokens[i].offset > length) return false;
+    if ((token == kEOF) != (i == count - 1)) return false;
+    int id = info.index();
+    switch (token) {
+      case kIDENTIFIER:
+        if (id < 0 || static_cast<u32>(id) >= header->identifier_count) {
+          return false;
+        }
+        break;
+
+      case kINTEGER:
+      case kDOUBLE:
+        if (id < 0 || static_cast<u32>(id) >= header->literal_count) {
+          return false;
+        }
+        break;
+
+      case kSTRING:
+      case kSTRING_INTERPOLATION:
+      case kSTRING_INTERPOLATION_END:
+        if (id < 0 || static_cast<u32>(id) >= header->string_count) {
+          return false;
+        }
+        break;
+
+      default:
+        // The parser skips a bracket by the offset to its match.
+        if (id > 0 && static_cast<u32>(id) >= count - i) return false;
+        break;
+    }
+  }
+
+  const Span* spans = header->identifiers();
+  u32 span_count = header->identifier_count + header->string_count;
+  for (u32 i = 0; i < span_count; i++) {
+    Span span = spans[i];
+    u64 end = static_cast<u64>(span.offset & ~Span::kInBytes) + span.length;
+    u32 limit = ((span.offset & Span::kInBytes) != 0)
+        ? header->byte_count
+        : length;
+    if (end > limit) return false;
+    // Keywords are never registered as identifiers.
+    if (i < header->identifier_count) {
+      StringSlice name = ResolveSpan(span, source, header->bytes());
+      if (Tokens::LookupKeyword(name.data(), name.length()) != kIDENTIFIER) {
+        return false;
+      }
+    }
+  }
+
+  const Literal* literals = header->literals();
+  for (u32 i = 0; i < header->literal_count; i++) {
+    Literal literal = literals[i];
+    if (literal.is_double > 1) return false;
+    // Integer literals are never negative.
+    if (!literal.is_double && static_cast<i64>(literal.bits) < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void TokenCache::Store(const char* path, Builder* builder,
+                       List<TokenInfo> tokens, int first_string,
+                       const char* source, u32 length, u64 hash,
+                       Location location) {
+  Zone zone;
+  // Give the terminals the tokens use ids of their own, in the order
+  // they are first used.
+  List<StringSlice> all_identifiers = builder->Identifiers();
+  List<TreeNode*> all_literals = builder->Registry();
+  List<int> identifier_ids = List<int>::New(&zone, all_identifiers.length());
+  for (int i = 0; i < identifier_ids.length(); i++) identifier_ids[i] = -1;
+  List<int> literal_ids = List<int>::New(&zone, all_literals.length());
+  for (int i = 0; i < literal_ids.length(); i++) literal_ids[i] = -1;
+  ListBuilder<StringSlice, 256> identifiers(&zone);
+  ListBuilder<TreeNode*, 256> literals(&zone);
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.hash = hash;
+  header.source_length = length;
+  header.token_count = tokens.length();
+  header.string_count = builder->string_count() - first_string;
+
+  List<CachedToken> cached = List<CachedToken>::New(&zone, tokens.length());
+  for (int i = 0; i < tokens.length(); i++) {
+    TokenInfo info = tokens[i];
+    int id = info.index();
+    switch (info.token()) {
+      case kIDENTIFIER:
+        if (identifier_ids[id] < 0) {
+          identifier_ids[id] = identifiers.length();
+          identifiers.Add(all_identifiers[id]);
+        }
+        id = identifier_ids[id];
+        break;
+
+      case kINTEGER:
+      case kDOUBLE:
+        if (literal_ids[id] < 0) {
+          literal_ids[id] = literals.length();
+          literals.Add(all_literals[id]);
+        }
+        id = literal_ids[id];
+        break;
+
+      case kSTRING:
+      case kSTRING_INTERPOLATION:
+      case kSTRING_INTERPOLATION_END:
+        id -= first_string;
+        break;
+
+      default:
+        break;
+    }
+    cached[i].value = info.WithIndex(id).value();
+    cached[i].offset = info.location().raw() - location.raw();
+  }
+  header.identifier_count = identifiers.length();
+  header.literal_count = literals.length();
+
+  // Terminals that aren't in the source, like decoded strings, are
+  // copied to the end of the entry.
+  ListBuilder<StringSlice, 256> slices(&zone);
+  for (int i = 0; i < identifiers.length(); i++) {
+    slices.Add(identifiers.Get(i));
+  }
+  for (u32 i = 0; i < header.string_count; i++) {
+    slices.Add(builder->LookupString(first_string + i)->value());
+  }
+  List<StringSlice> all_slices = slices.ToList();
+  for (int i = 0; i < all_slices.length(); i++) {
+    StringSlice slice = all_slices[i];
+    if (slice.data() < source || slice.data() > source + length) {
+      header.byte_count += slice.length();
+    }
+  }
+  header.byte_count = Utils::RoundUp(header.byte_count, 8);
+
+  u64 size = header.ComputeSize();
+  List<u8> bytes = List<u8>::New(&zone, size);
+  Header* entry = reinterpret_cast<Header*>(bytes.data());
+  *entry = header;
+  memcpy(const_cast<CachedToken*>(entry->tokens()), cached.data(),
+         tokens.length() * sizeof(CachedToken));
+  Span* spans = const_cast<Span*>(entry->identifiers());
+  char* characters = const_cast<char*>(entry->bytes());
+  u32 byte_count = 0;
+  for (int i = 0; i < all_slices.length(); i++) {
+    AddSpan(&spans[i], all_slices[i], source, length, characters,
+            &byte_count);
+  }
+  memset(characters + byte_count, 0, header.byte_count - byte_count);
+  Literal* literal = const_cast<Literal*>(entry->literals());
+  for (int i = 0; i < literals.length(); i++, literal++) {
+    TreeNode* node = literals.Get(i);
+    literal->padding = 0;
+    if (node->IsLiteralInteger()) {
+      literal->is_double = 0;
+      literal->bits = node->AsLiteralInteger()->value();
+    } else {
+      literal->is_double = 1;
+      literal->bits = bit_cast<u64>(node->AsLiteralDouble()->value());
+    }
+  }
+
+  // Write the entry to a temporary file first and then move it into
+  // place in one step, so a build never sees a partially written entry.
+  // The temporary name is unique to this process and store, so builds
+  // storing the same entry at the same time don't write into each
+  // other's files.
+  static std::atomic<u32> store_count(0);
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), ".%d.%u.tmp", OS::ProcessId(),
+           static_cast<unsigned>(store_count++));
+  const char* temporary = EntryPath(&zone, hash, suffix);
+  if (!OS::StoreFile(temporary, bytes) || !OS::RenameFile(temporary, path)) {
+    OS::DeleteFile(temporary);
+  }
+}
+
+void TokenCache::AddSpan(Span* span, StringSlice slice, const char* source,
+                         u32 length, char* bytes, u32* byte_count) {
+  span->length = slice.length();
+  if (slice.data() >= source && slice.data() <= source + length) {
+    span->offset = slice.data() - source;
+  } else {
+    span->offset = *byte_count | Span::kInBytes;
+    memcpy(bytes + *byte_count, slice.data(), slice.length());
+    *byte_count += slice.length();
+  }
+}
+
+TokenColumns TokenCache::Adopt(const Header* header, Builder* builder,
+                               Zone* zone, const char* source,
+                               Location location) {
+  // Register the terminals with the builder, in the order a scan would
+  // have registered them, and remember their ids in the builder. The
+  // builder keeps the slices, so the bytes are copied out of the entry
+  // into the builder's zone before the entry is unmapped.
+  const Span* spans = header->identifiers();
+  char* bytes = static_cast<char*>(
+      builder->zone()->Allocate(header->byte_count));
+  memcpy(bytes, header->bytes(), header->byte_count);
+  List<int> identifier_ids = List<int>::New(zone, header->identifier_count);
+  for (u32 i = 0; i < header->identifier_count; i++) {
+    identifier_ids[i] = builder->ComputeCanonicalId(
+        ResolveSpan(spans[i], source, bytes));
+  }
+  int first_string = builder->string_count();
+  spans = header->strings();
+  for (u32 i = 0; i < header->string_count; i++) {
+    builder->RegisterString(ResolveSpan(spans[i], source, bytes));
+  }
+  const Literal* literals = header->literals();
+  List<int> literal_ids = List<int>::New(zone, header->literal_count);
+  for (u32 i = 0; i < header->literal_count; i++) {
+    Literal literal = literals[i];
+    literal_ids[i] = literal.is_double
+        ? builder->ComputeCanonicalDoubleId(bit_cast<double>(literal.bits))
+        : builder->ComputeCanonicalIntegerId(literal.bits);
+  }
+
+  int length = header->token_count;
+  List<u8> kinds = List<u8>::New(zone, length);
+  List<int> indexes = List<int>::New(zone, length);
+  List<Location> locations = List<Location>::New(zone, length);
+  const CachedToken* tokens = header->tokens();
+  for (int i = 0; i < length; i++) {
+    TokenInfo info(tokens[i].value, Location());
+    Token token = info.token();
+    int id = info.index();
+    switch (token) {
+      case kIDENTIFIER:
+        id = identifier_ids[id];
+        break;
+
+      case kINTEGER:
+      case kDOUBLE:
+        id = literal_ids[id];
+        break;
+
+      case kSTRING:
+      case kSTRING_INTERPOLATION:
+      case kSTRING_INTERPOLATION_END:
+        id += first_string;
+        break;
+
+      default:
+        break;
+    }
+    kinds[i] = token;
+    indexes[i] = id;
+    locations[i] = location + tokens[i].offset;
+  }
+  return TokenColumns(kinds, indexes, locations);
+}
+
+StringSlice TokenCache::ResolveSpan(Span span, const char* source,
+                                    const char* bytes) {
+  if ((span.offset & Span::kInBytes) != 0) {
+    return StringSlice(bytes + (span.offset & ~Span::kInBytes), span.length);
+  }
+  return StringSlice(source + span.offset, span.length);
+}
+
+}  // namespace rart
@@ -0,0 +1,82 @@
+// Copyright (c) 2015, the Rart project authors. Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE.md file.
+
+#ifndef SRC_TOKEN_CACHE_H_
+#define SRC_TOKEN_CACHE_H_
+
+#include "src/builder.h"
+#include "src/scanner.h"
+#include "src/string_slice.h"
+#include "src/zone.h"
+
+namespace rart {
+
+// An on-disk cache of scanner output, so unchanged files don't have to be
+// scanned again. Each entry holds the tokens of one source together with
+// the identifiers, strings and numbers the scan registered, and is keyed
+// by a hash of the source text. Entries are mapped straight into memory
+// when they are loaded, and their ids are remapped into the live builder.
+// Bracket offsets are relative, so the tokens need no other fixups.
+class TokenCache : public StackAllocated {
+ public:
+  // The directory is created if it doesn't exist.
+  explicit TokenCache(const char* directory);
+
+  // Returns the tokens of the zero-terminated source that starts at the
+  // given location. Their terminals are registered with the builder, and
+  // the token columns are allocated in the zone. On a miss the source is
+  // scanned and an entry is stored for the next time, unless the scan
+  // reported errors.
+  TokenColumns Scan(Builder* builder, Zone* zone, const char* source,
+                    Location location);
+
+  int hits() const { return hits_; }
+  int misses() const { return misses_; }
+
+ private:
+  struct Header;
+  struct CachedToken;
+  struct Span;
+  struct Literal;
+
+  static const u32 kMagic = 0x434b5452;  // "RTKC"
+  static const u32 kVersion = 1;
+
+  const char* const directory_;
+  int hits_ = 0;
+  int misses_ = 0;
+
+  const char* EntryPath(Zone* zone, u64 hash, const char* suffix);
+
+  // Returns the entry for the source if there is a valid one. The entry
+  // is mapped until the caller unmaps it.
+  const Header* Load(const char* path, u64 hash, const char* source,
+                     u32 length);
+
+  // Checks that every id, span and offset in a mapped entry of the right
+  // size is in range, so a damaged entry is never used.
+  static bool IsValid(const Header* header, const char* source);
+
+  // Writes an entry for tokens that were just scanned. The strings
+  // registered from first_string on came from the scan.
+  void Store(const char* path, Builder* builder, List<TokenInfo> tokens,
+             int first_string, const char* source, u32 length, u64 hash,
+             Location location);
+
+  // Fills in a span for the slice, copying its characters to the bytes
+  // if they are not in the source.
+  static void AddSpan(Span* span, StringSlice slice, const char* source,
+                      u32 length, char* bytes, u32* byte_count);
+  static StringSlice ResolveSpan(Span span, const char* source,
+                                 const char* bytes);
+
+  // Registers the terminals of an entry with the builder and returns the
+  // tokens with their ids remapped.
+  TokenColumns Adopt(const Header* header, Builder* builder, Zone* zone,
+                     const char* source, Location location);
+};
+
+}  // namespace rart
+
+#endif  // SRC_TOKEN_CACHE_H_
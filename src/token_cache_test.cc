@@ -0,0 +1,291 @@
+// Copyright (c) 2015, the Rart project authors. Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE.md file.
+
+#define TESTING
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/assert.h"
+#include "src/builder.h"
+#include "src/os.h"
+#include "src/pretty_printer.h"
+#include "src/string_buffer.h"
+#include "src/test_case.h"
+#include "src/token_cache.h"
+#include "src/utils.h"
+#include "src/zone.h"
+
+namespace rart {
+
+static const char* kLibrary =
+    "class Point {\n"
+    "  final x = 1.5, y = 0x10;\n"
+    "  toString() => 'Point(\\x41 $x, ${y + 2})';\n"
+    "  get length => [x, y, 42].length;\n"
+    "}\n";
+
+static const char* kUser =
+    "main() {\n"
+    "  var p = new Point();\n"
+    "  print(p.x + 1.5 + 42);\n"
+    "  print('\\u{1F600} ${p.toString()}');\n"
+    "}\n";
+
+// Builds the sources in order with one builder, and returns the pretty
+// printed last unit.
+static const char* Build(Zone* zone, TokenCache* cache,
+                         const char* first, const char* second = NULL) {
+  Builder builder(zone);
+  builder.set_token_cache(cache);
+  Location location = builder.source()->LoadFromBuffer(
+      "<first>", first, strlen(first));
+  CompilationUnitNode* unit = builder.BuildUnit(location);
+  if (second != NULL) {
+    location = builder.source()->LoadFromBuffer(
+        "<second>", second, strlen(second));
+    unit = builder.BuildUnit(location);
+  }
+  PrettyPrinter printer(zone);
+  unit->Accept(&printer);
+  return printer.Output();
+}
+
+static const char* CreateCacheDirectory(Zone* zone) {
+  const char* name = "/tmp/rart_token_cache_XXXXXX";
+  char* directory = static_cast<char*>(zone->Allocate(strlen(name) + 1));
+  strcpy(directory, name);  // NOLINT
+  EXPECT(mkdtemp(directory) != NULL);
+  return directory;
+}
+
+// Deletes the entries in a directory made by CreateCacheDirectory, and
+// the directory. Stores leave no temporary files behind.
+static void DeleteCacheDirectory(Zone* zone, const char* directory) {
+  DIR* entries = opendir(directory);
+  EXPECT(entries != NULL);
+  struct dirent* entry;
+  while ((entry = readdir(entries)) != NULL) {
+    const char* name = entry->d_name;
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+    EXPECT(strstr(name, ".tmp") == NULL);
+    StringBuffer path(zone);
+    path.Print("%s/%s", directory, name);
+    EXPECT(OS::DeleteFile(path.ToString()));
+  }
+  closedir(entries);
+  EXPECT(rmdir(directory) == 0);
+}
+
+TEST_CASE(TokenCacheHit) {
+  Zone zone;
+  const char* directory = CreateCacheDirectory(&zone);
+  const char* expected = Build(&zone, NULL, kLibrary);
+
+  TokenCache cache(directory);
+  EXPECT_STREQ(expected, Build(&zone, &cache, kLibrary));
+  EXPECT_EQ(0, cache.hits());
+  EXPECT_EQ(1, cache.misses());
+  // A new cache on the same directory finds the entry.
+  TokenCache other(directory);
+  EXPECT_STREQ(expected, Build(&zone, &other, kLibrary));
+  EXPECT_EQ(1, other.hits());
+  EXPECT_EQ(0, other.misses());
+
+  // Identifiers that were first seen in another file are stored in the
+  // entry, so they are there when the file is loaded on its own.
+  expected = Build(&zone, NULL, kUser);
+  EXPECT_STREQ(expected, Build(&zone, &cache, kLibrary, kUser));
+  EXPECT_EQ(1, cache.hits());
+  EXPECT_EQ(2, cache.misses());
+  EXPECT_STREQ(expected, Build(&zone, &cache, kUser));
+  EXPECT_EQ(2, cache.hits());
+  // The ids in an entry don't depend on what the builder has seen.
+  expected = Build(&zone, NULL, kUser, kLibrary);
+  EXPECT_STREQ(expected, Build(&zone, &cache, kUser, kLibrary));
+  EXPECT_EQ(4, cache.hits());
+  DeleteCacheDirectory(&zone, directory);
+}
+
+TEST_CASE(TokenCacheInvalidEntry) {
+  Zone zone;
+  const char* directory = CreateCacheDirectory(&zone);
+  TokenCache cache(directory);
+  const char* expected = Build(&zone, &cache, kLibrary);
+  // Overwrite the entry with something that isn't an entry.
+  StringBuffer path(&zone);
+  path.Print("%s/%016" PRIx64 ".tokens", directory,
+             Utils::ContentHash(kLibrary, strlen(kLibrary)));
+  u8 garbage[64];
+  memset(garbage, 0x2a, sizeof(garbage));
+  EXPECT(OS::StoreFile(path.ToString(), List<u8>(garbage, sizeof(garbage))));
+  EXPECT_STREQ(expected, Build(&zone, &cache, kLibrary));
+  EXPECT_EQ(0, cache.hits());
+  EXPECT_EQ(2, cache.misses());
+  // The miss replaced the entry.
+  EXPECT_STREQ(expected, Build(&zone, &cache, kLibrary));
+  EXPECT_EQ(1, cache.hits());
+  DeleteCacheDirectory(&zone, directory);
+}
+
+// A word to replace in a cache entry, at a byte offset into the entry.
+struct Damage {
+  int offset;
+  u32 value;
+};
+
+// Replaces the entry at 'path' with a copy of 'entry' with the damage
+// done to it. The copy has the size of the original.
+static void StoreDamagedEntry(Zone* zone, const char* path, List<u8> entry,
+                              const Damage* damage, int count) {
+  List<u8> copy = List<u8>::New(zone, entry.length());
+  memcpy(copy.data(), entry.data(), entry.length());
+  for (int i = 0; i < count; i++) {
+    memcpy(copy.data() + damage[i].offset, &damage[i].value, sizeof(u32));
+  }
+  EXPECT(OS::StoreFile(path, copy));
+}
+
+static u32 EntryWord(List<u8> entry, int offset) {
+  u32 value;
+  memcpy(&value, entry.data() + offset, sizeof(value));
+  return value;
+}
+
+TEST_CASE(TokenCacheDamagedEntry) {
+  // Entries of the right size whose contents are out of range are not
+  // used, whatever they point at.
+  Zone zone;
+  const char* directory = CreateCacheDirectory(&zone);
+  TokenCache cache(directory);
+  const char* expected = Build(&zone, &cache, kLibrary);
+  StringBuffer path(&zone);
+  path.Print("%s/%016" PRIx64 ".tokens", directory,
+             Utils::ContentHash(kLibrary, strlen(kLibrary)));
+  u32 size = 0;
+  u8* data = reinterpret_cast<u8*>(
+      OS::LoadFile(path.ToString(), &zone, &size));
+  EXPECT(data != NULL);
+  List<u8> entry(data, size);
+
+  // The header is eight words: magic, version, the hash in two words,
+  // the source length and the counts of tokens, identifiers, strings,
+  // literals and bytes. The tokens follow, two words each, and then the
+  // spans of the identifiers, two words each.
+  const int kSourceLength = 16;
+  const int kIdentifierCount = 24;
+  const int kStringCount = 28;
+  const int kTokens = 40;
+  u32 token_count = EntryWord(entry, 20);
+  u32 identifier_count = EntryWord(entry, kIdentifierCount);
+  int spans = kTokens + token_count * 8;
+  int identifier = kTokens;
+  while ((EntryWord(entry, identifier) & 0x7F) != kIDENTIFIER) {
+    identifier += 8;
+  }
+  int last = kTokens + (token_count - 1) * 8;
+  Damage damages[][2] = {
+    // An identifier id past the identifiers.
+    { { identifier, (identifier_count << 8) | kIDENTIFIER }, { 0, 0 } },
+    // A token kind that doesn't exist.
+    { { identifier, 0x7F }, { 0, 0 } },
+    // A location past the end of the source.
+    { { identifier + 4, EntryWord(entry, kSourceLength) + 1 }, { 0, 0 } },
+    // No EOF token at the end.
+    { { last, (identifier_count - 1) << 8 | kIDENTIFIER }, { 0, 0 } },
+    // A bracket offset past the end.
+    { { kTokens, (token_count << 8) | kLBRACE }, { 0, 0 } },
+    // An identifier span that reaches past the end of the source.
+    { { spans, EntryWord(entry, kSourceLength) }, { 0, 0 } },
+    // Counts whose sum wraps around to the original sum.
+    { { kIdentifierCount, identifier_count + 0x80000000 },
+      { kStringCount, EntryWord(entry, kStringCount) + 0x80000000 } },
+  };
+  int count = sizeof(damages) / sizeof(damages[0]);
+  for (int i = 0; i < count; i++) {
+    StoreDamagedEntry(&zone, path.ToString(), entry, damages[i],
+                      (damages[i][1].offset == 0) ? 1 : 2);
+    EXPECT_STREQ(expected, Build(&zone, &cache, kLibrary));
+    EXPECT_EQ(0, cache.hits());
+    EXPECT_EQ(2 + i, cache.misses());
+  }
+  // The last miss replaced the entry.
+  EXPECT_STREQ(expected, Build(&zone, &cache, kLibrary));
+  EXPECT_EQ(1, cache.hits());
+  DeleteCacheDirectory(&zone, directory);
+}
+
+TEST_CASE(TokenCacheScanErrors) {
+  // Scans with errors are not cached, so the errors are reported again.
+  Zone zone;
+  const char* directory = CreateCacheDirectory(&zone);
+  TokenCache cache(directory);
+  const char* source = "main() { var s = 'abc; }";
+  int errors[2];
+  for (int i = 0; i < 2; i++) {
+    Builder builder(&zone);
+    builder.set_token_cache(&cache);
+    Location location = builder.source()->LoadFromBuffer(
+        "<errors>", source, strlen(source));
+    builder.BuildUnit(location);
+    errors[i] = builder.error_count();
+  }
+  EXPECT_GT(errors[0], 0);
+  EXPECT_EQ(errors[0], errors[1]);
+  EXPECT_EQ(0, cache.hits());
+  EXPECT_EQ(2, cache.misses());
+  DeleteCacheDirectory(&zone, directory);
+}
+
+TEST_CASE(TokenCacheSpeed) {
+  Zone zone;
+  const int REPEAT = 5;
+  StringBuffer buffer(&zone);
+  for (int i = 0; i < 4000; i++) {
+    buffer.Print(
+        "  /**\n"
+        "   * Returns the sum of [a] and [b].\n"
+        "   */\n"
+        "  int add%d(int a, int b) {\n"
+        "    // Add them up.\n"
+        "    return a + b * %d + '\\x41';\n"
+        "  }\n"
+        "\n",
+        i, i);
+  }
+  const char* input = buffer.ToString();
+  size_t length = strlen(input);
+  const char* directory = CreateCacheDirectory(&zone);
+  TokenCache cache(directory);
+  i64 scan = 0;
+  i64 hit = 0;
+  for (int i = 0; i < REPEAT + 1; i++) {
+    Zone scan_zone;
+    Builder builder(&scan_zone);
+    i64 start = OS::CurrentTime();
+    if (i == 0) {
+      cache.Scan(&builder, &scan_zone, input, Location());
+      continue;
+    }
+    Scanner scanner(&scan_zone, &builder);
+    scanner.Scan(input, Location());
+    scanner.EncodedTokenColumns();
+    i64 middle = OS::CurrentTime();
+    Builder cached_builder(&scan_zone);
+    cache.Scan(&cached_builder, &scan_zone, input, Location());
+    scan += middle - start;
+    hit += OS::CurrentTime() - middle;
+  }
+  EXPECT_EQ(REPEAT, cache.hits());
+  if (scan <= 0) scan = 1;
+  if (hit <= 0) hit = 1;
+  printf("TokenCacheSpeed: scan %.1f MB/s, cache hit %.1f MB/s\n",
+         static_cast<double>(length) * REPEAT / scan,
+         static_cast<double>(length) * REPEAT / hit);
+  DeleteCacheDirectory(&zone, directory);
+}
+
+}  // namespace rart
@@ -6,16 +6,49 @@
 
 namespace rart {
 
-int Tokens::precedence_[] = {
+const int Tokens::precedence_[] = {
 #define T(n, s, p) p,
 TOKEN_LIST(T)
 #undef T
 };
 
-const char* Tokens::syntax_[] = {
+const char* const Tokens::syntax_[] = {
 #define T(n, s, p) s,
 TOKEN_LIST(T)
 #undef T
 };
 
+const u8 Tokens::syntax_length_[] = {
+#define T(n, s, p) sizeof(s) - 1,
+TOKEN_LIST(T)
+#undef T
+};
+
+static constexpr Token KeywordForSlot(int slot) {
+  return
+#define T(n, s, p) (Tokens::KeywordHash(s, sizeof(s) - 1) == slot) ? n :
+KEYWORD_LIST(T)
+#undef T
+      kIDENTIFIER;
+}
+
+// Each keyword must be the one found in its own slot; otherwise an
+// earlier keyword hashes to the same slot.
+#define T(n, s, p)                                                  \
+  static_assert(KeywordForSlot(                                     \
+                    Tokens::KeywordHash(s, sizeof(s) - 1)) == n,    \
+                "Keyword hash collision: " s);                      \
+  static_assert(sizeof(s) - 1 >= Tokens::kMinimumKeywordLength &&   \
+                sizeof(s) - 1 <= Tokens::kMaximumKeywordLength,     \
+                "Keyword length out of range: " s);
+KEYWORD_LIST(T)
+#undef T
+
+#define S(n) KeywordForSlot(n),
+static_assert(Tokens::kKeywordTableSize == 128, "Update the table below");
+const Token Tokens::keyword_table_[kKeywordTableSize] = {
+  REPEAT_64(S, 0) REPEAT_64(S, 64)
+};
+#undef S
+
 }  // namespace rart
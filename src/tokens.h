@@ -5,6 +5,8 @@
 #ifndef SRC_TOKENS_H_
 #define SRC_TOKENS_H_
 
+#include <string.h>
+
 #include "src/globals.h"
 #include "src/source.h"
 
@@ -178,28 +180,74 @@ class TokenInfo {
   TokenInfo() : value_(0), location_() {
   }
 
-  Token token() const { return static_cast<Token>(value_ & 0xFF); }
+  // Tokens that are not the first token scanned at the top level, like
+  // the parts of a string interpolation or the second half of '>>', are
+  // marked as continuations. Incremental rescanning only restarts and
+  // resynchronizes at tokens that are not continuations.
+  static const u32 kContinuationBit = 0x80;
+
+  // The token, the continuation bit and the index packed into a word.
+  u32 value() const { return value_; }
+
+  Token token() const { return static_cast<Token>(value_ & 0x7F); }
   int index() const { return static_cast<int>(value_) >> 8; }
+  bool is_continuation() const { return (value_ & kContinuationBit) != 0; }
 
   Location location() const { return location_; }
 
+  TokenInfo WithIndex(int index) const {
+    return TokenInfo(static_cast<u32>(index) << 8 | (value_ & 0xFF), location_);
+  }
+
+  TokenInfo WithLocation(Location location) const {
+    return TokenInfo(value_, location);
+  }
+
  private:
   u32 value_;
   Location location_;
 };
 
+static_assert(kGT_START < TokenInfo::kContinuationBit,
+              "Tokens must leave room for the continuation bit");
+
 class Tokens {
  public:
   static inline bool IsIdentifier(Token token);
 
+  // Returns the keyword token spelled by the given characters, or
+  // kIDENTIFIER if they don't spell a keyword. This takes a single
+  // hash and a single comparison.
+  static inline Token LookupKeyword(const char* name, int length);
+
+  // The keywords are perfectly hashed into a table of this size. The
+  // shortest keywords have two characters, so the hash can use the first
+  // two characters, the last character and the length. The multipliers
+  // were picked so no two keywords end up in the same slot; tokens.cc
+  // checks that at compile time.
+  static const int kKeywordTableSize = 128;
+  static const int kMinimumKeywordLength = 2;
+  static const int kMaximumKeywordLength = 10;
+
+  static constexpr int KeywordHash(const char* name, int length) {
+    return (name[0] * 10 + name[1] * 50 + name[length - 1] + length * 2)
+        & (kKeywordTableSize - 1);
+  }
+
   static int Precedence(Token token) { return precedence_[token]; }
   static const char* Syntax(Token token) { return syntax_[token]; }
+  static int SyntaxLength(Token token) { return syntax_length_[token]; }
 
   static const int kNumberOfBuiltins = kTYPEDEF - kABSTRACT + 1;
 
  private:
-  static int precedence_[];
-  static const char* syntax_[];
+  // The tables are constant so they are shared by all threads and never
+  // need any setup at runtime.
+  static const int precedence_[];
+  static const char* const syntax_[];
+  static const u8 syntax_length_[];
+
+  static const Token keyword_table_[kKeywordTableSize];
 };
 
 bool Tokens::IsIdentifier(Token token) {
@@ -207,6 +255,17 @@ bool Tokens::IsIdentifier(Token token) {
       || ((token >= kABSTRACT) && (token <= kTYPEDEF));
 }
 
+Token Tokens::LookupKeyword(const char* name, int length) {
+  if (length < kMinimumKeywordLength || length > kMaximumKeywordLength) {
+    return kIDENTIFIER;
+  }
+  Token token = keyword_table_[KeywordHash(name, length)];
+  if (token == kIDENTIFIER) return kIDENTIFIER;
+  if (syntax_length_[token] != length) return kIDENTIFIER;
+  if (memcmp(syntax_[token], name, length) != 0) return kIDENTIFIER;
+  return token;
+}
+
 }  // namespace rart
 
 #endif  // SRC_TOKENS_H_
@@ -98,15 +98,26 @@ MethodNode::MethodNode(
     TreeNode* name,
     List<VariableDeclarationNode*> parameters,
     List<TreeNode*> initializers,
-    TreeNode* body)
+    TreeNode* body,
+    LazyBody* lazy_body)
     : modifiers_(modifiers)
     , name_(name)
     , parameters_(parameters)
     , initializers_(initializers)
     , body_(body)
+    , lazy_body_(lazy_body)
     , id_(-1)
     , owner_(NULL)
     , link_(NULL) {
+  ASSERT((body == NULL) != (lazy_body == NULL));
+}
+
+TreeNode* MethodNode::body() {
+  if (body_ == NULL) {
+    body_ = lazy_body_->Parse();
+    lazy_body_ = NULL;
+  }
+  return body_;
 }
 
 int MethodNode::OptionalParameterCount() const {
@@ -336,7 +347,7 @@ NewNode::NewNode(bool is_const, InvokeNode* invoke)
     , invoke_(invoke) {
 }
 
-IdentifierNode::IdentifierNode(int id, const char* value, Location location)
+IdentifierNode::IdentifierNode(int id, StringSlice value, Location location)
     : id_(id)
     , value_(value)
     , location_(location) {
@@ -368,7 +379,7 @@ LiteralDoubleNode::LiteralDoubleNode(double value)
     : value_(value) {
 }
 
-LiteralStringNode::LiteralStringNode(const char* value)
+LiteralStringNode::LiteralStringNode(StringSlice value)
     : value_(value) {
 }
 
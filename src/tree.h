@@ -7,6 +7,7 @@
 
 #include "src/allocation.h"
 #include "src/list.h"
+#include "src/string_slice.h"
 #include "src/tokens.h"
 
 namespace rart {
@@ -306,20 +307,32 @@ class TypedefNode : public TreeNode {
   const List<TreeNode*> parameters_;
 };
 
+// The block body of a method that has not been parsed yet. See
+// Builder::set_lazy_method_bodies.
+class LazyBody : public ZoneAllocated {
+ public:
+  virtual ~LazyBody() {}
+  virtual TreeNode* Parse() = 0;
+};
+
 class MethodNode : public TreeNode {
  public:
   MethodNode(Modifiers modifiers,
              TreeNode* name,
              List<VariableDeclarationNode*> parameters,
              List<TreeNode*> initializers,
-             TreeNode* body);
+             TreeNode* body,
+             LazyBody* lazy_body = NULL);
   IMPLEMENTS(Method)
 
   Modifiers modifiers() const { return modifiers_; }
   TreeNode* name() const { return name_; }
   List<VariableDeclarationNode*> parameters() const { return parameters_; }
   List<TreeNode*> initializers() const { return initializers_; }
-  TreeNode* body() const { return body_; }
+
+  // Parses a lazy body the first time it is called.
+  TreeNode* body();
+  bool is_body_parsed() const { return body_ != NULL; }
 
   int OptionalParameterCount() const;
 
@@ -341,7 +354,8 @@ class MethodNode : public TreeNode {
   TreeNode* const name_;
   const List<VariableDeclarationNode*> parameters_;
   const List<TreeNode*> initializers_;
-  TreeNode* const body_;
+  TreeNode* body_;
+  LazyBody* lazy_body_;
   int id_;
   TreeNode* owner_;
   List<VariableDeclarationNode*> captured_;
@@ -681,10 +695,12 @@ class ParenthesizedNode : public ExpressionNode {
   IMPLEMENTS(Parenthesized);
 
   Location location() const { return location_; }
+  // Incremental builds move reused nodes to the edited source.
+  void set_location(Location location) { location_ = location; }
   ExpressionNode* expression() const { return expression_; }
 
  private:
-  const Location location_;
+  Location location_;
   ExpressionNode* const expression_;
 };
 
@@ -862,17 +878,18 @@ class NewNode : public ExpressionNode {
 
 class IdentifierNode : public ExpressionNode {
  public:
-  IdentifierNode(int id, const char* value, Location location);
+  IdentifierNode(int id, StringSlice value, Location location);
   IMPLEMENTS(Identifier)
 
   int id() const { return id_; }
-  const char* value() const { return value_; }
+  StringSlice value() const { return value_; }
   Location location() const { return location_; }
+  void set_location(Location location) { location_ = location; }
 
  private:
   const int id_;
-  const char* const value_;
-  const Location location_;
+  const StringSlice value_;
+  Location location_;
 };
 
 class ThisNode : public ExpressionNode {
@@ -960,13 +977,13 @@ class LiteralDoubleNode : public ExpressionNode {
 
 class LiteralStringNode : public ExpressionNode {
  public:
-  explicit LiteralStringNode(const char* value);
+  explicit LiteralStringNode(StringSlice value);
   IMPLEMENTS(LiteralString)
 
-  const char* value() const { return value_; }
+  StringSlice value() const { return value_; }
 
  private:
-  const char* const value_;
+  const StringSlice value_;
 };
 
 class LiteralBooleanNode : public ExpressionNode {
@@ -0,0 +1,84 @@
+// Copyright (c) 2015, the Rart project authors. Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE.md file.
+
+#include "src/assert.h"
+#include "src/simd.h"
+#include "src/utf8.h"
+
+namespace rart {
+
+int Utf8::Validate(const char* data, int length) {
+  const char* end = data + length;
+  const char* p = data;
+  while (true) {
+    p = Simd::FindNonAscii(p, end);
+    if (p == end) return -1;
+    // Non-ASCII text tends to come in runs, so stay in the scalar loop
+    // until the next ASCII byte.
+    do {
+      int sequence = SequenceLength(reinterpret_cast<const u8*>(p),
+                                    reinterpret_cast<const u8*>(end));
+      if (sequence == 0) return p - data;
+      p += sequence;
+    } while (p < end && static_cast<u8>(*p) >= 0x80);
+  }
+}
+
+int Utf8::SequenceLength(const u8* p, const u8* end) {
+  u8 lead = p[0];
+  ASSERT(lead >= 0x80);
+  // The range of the second byte depends on the lead byte; this is what
+  // rules out overlong forms, surrogates and values above 0x10FFFF. The
+  // remaining bytes are plain continuation bytes.
+  int length;
+  u8 low = 0x80;
+  u8 high = 0xBF;
+  if (lead < 0xC2) {
+    return 0;
+  } else if (lead < 0xE0) {
+    length = 2;
+  } else if (lead < 0xF0) {
+    length = 3;
+    if (lead == 0xE0) low = 0xA0;
+    if (lead == 0xED) high = 0x9F;
+  } else if (lead < 0xF5) {
+    length = 4;
+    if (lead == 0xF0) low = 0x90;
+    if (lead == 0xF4) high = 0x8F;
+  } else {
+    return 0;
+  }
+  if (end - p < length) return 0;
+  if (p[1] < low || p[1] > high) return 0;
+  for (int i = 2; i < length; i++) {
+    if ((p[i] & 0xC0) != 0x80) return 0;
+  }
+  return length;
+}
+
+int Utf8::Encode(int code_point, char* buffer) {
+  ASSERT(code_point >= 0 && code_point <= kMaxCodePoint);
+  if (code_point < 0x80) {
+    buffer[0] = code_point;
+    return 1;
+  }
+  if (code_point < 0x800) {
+    buffer[0] = 0xC0 | (code_point >> 6);
+    buffer[1] = 0x80 | (code_point & 0x3F);
+    return 2;
+  }
+  if (code_point < 0x10000) {
+    buffer[0] = 0xE0 | (code_point >> 12);
+    buffer[1] = 0x80 | ((code_point >> 6) & 0x3F);
+    buffer[2] = 0x80 | (code_point & 0x3F);
+    return 3;
+  }
+  buffer[0] = 0xF0 | (code_point >> 18);
+  buffer[1] = 0x80 | ((code_point >> 12) & 0x3F);
+  buffer[2] = 0x80 | ((code_point >> 6) & 0x3F);
+  buffer[3] = 0x80 | (code_point & 0x3F);
+  return 4;
+}
+
+}  // namespace rart
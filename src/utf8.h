@@ -0,0 +1,37 @@
+// Copyright (c) 2015, the Rart project authors. Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE.md file.
+
+#ifndef SRC_UTF8_H_
+#define SRC_UTF8_H_
+
+#include "src/globals.h"
+
+namespace rart {
+
+class Utf8 {
+ public:
+  static const int kMaxEncodedLength = 4;
+  static const int kMaxCodePoint = 0x10FFFF;
+
+  // Checks that [data, data + length) is well-formed UTF-8: no stray
+  // continuation bytes, no truncated or overlong sequences, no encoded
+  // surrogates and nothing above kMaxCodePoint. Returns the offset of
+  // the first byte of the first bad sequence, or -1 if there is none.
+  // Runs of ASCII are skipped a vector at a time.
+  static int Validate(const char* data, int length);
+
+  // Writes the encoding of the code point to the buffer and returns the
+  // number of bytes written. Surrogates are encoded like any other code
+  // point, so unpaired \u escapes survive the trip.
+  static int Encode(int code_point, char* buffer);
+
+ private:
+  // Returns the length of the well-formed sequence starting with the
+  // non-ASCII byte at p, or 0 if the sequence is bad.
+  static int SequenceLength(const u8* p, const u8* end);
+};
+
+}  // namespace rart
+
+#endif  // SRC_UTF8_H_
@@ -0,0 +1,108 @@
+// Copyright (c) 2015, the Rart project authors. Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE.md file.
+
+#define TESTING
+
+#include <stdio.h>
+#include <string.h>
+
+#include "src/assert.h"
+#include "src/os.h"
+#include "src/simd.h"
+#include "src/test_case.h"
+#include "src/utf8.h"
+#include "src/zone.h"
+
+namespace rart {
+
+static int Validate(const char* input) {
+  return Utf8::Validate(input, strlen(input));
+}
+
+TEST_CASE(Utf8Validate) {
+  EXPECT_EQ(-1, Validate(""));
+  EXPECT_EQ(-1, Validate("plain ascii"));
+  EXPECT_EQ(-1, Validate("\xc3\xa9t\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80"));
+  EXPECT_EQ(-1, Validate("\xed\x9f\xbf \xee\x80\x80 \xf4\x8f\xbf\xbf"));
+
+  // Stray continuation bytes and bad lead bytes.
+  EXPECT_EQ(1, Validate("a\x80"));
+  EXPECT_EQ(0, Validate("\xbf"));
+  EXPECT_EQ(0, Validate("\xf5\x80\x80\x80"));
+  EXPECT_EQ(0, Validate("\xff"));
+  // Overlong encodings.
+  EXPECT_EQ(0, Validate("\xc0\xaf"));
+  EXPECT_EQ(0, Validate("\xc1\xbf"));
+  EXPECT_EQ(0, Validate("\xe0\x9f\xbf"));
+  EXPECT_EQ(0, Validate("\xf0\x8f\xbf\xbf"));
+  // Surrogates and code points above 0x10FFFF.
+  EXPECT_EQ(0, Validate("\xed\xa0\x80"));
+  EXPECT_EQ(0, Validate("\xed\xbf\xbf"));
+  EXPECT_EQ(0, Validate("\xf4\x90\x80\x80"));
+  // Truncated sequences, including at the end of the input.
+  EXPECT_EQ(2, Validate("ab\xe2\x82"));
+  EXPECT_EQ(0, Validate("\xe2\x82x"));
+  EXPECT_EQ(3, Validate("\xc3\xa9x\xf0\x9f\x98"));
+}
+
+TEST_CASE(Utf8ValidateAlignment) {
+  // Put a bad byte at every position after runs of ASCII and of
+  // multibyte characters, so it is found in and after vector blocks.
+  char buffer[200];
+  for (int length = 0; length < 100; length++) {
+    memset(buffer, 'a', length);
+    buffer[length] = '\x80';
+    EXPECT_EQ(length, Utf8::Validate(buffer, length + 1));
+    EXPECT_EQ(-1, Utf8::Validate(buffer, length));
+    for (int i = 0; i + 1 < length; i += 2) {
+      buffer[i] = '\xc3';
+      buffer[i + 1] = '\xa9';
+    }
+    EXPECT_EQ(length, Utf8::Validate(buffer, length + 1));
+    buffer[length] = '\xc3';
+    EXPECT_EQ(length, Utf8::Validate(buffer, length + 1));
+  }
+}
+
+TEST_CASE(Utf8Encode) {
+  int code_points[] = { 0, 0x7F, 0x80, 0x7FF, 0x800, 0xD800, 0xFFFF,
+                        0x10000, 0x10FFFF };
+  int lengths[] = { 1, 1, 2, 2, 3, 3, 3, 4, 4 };
+  for (unsigned i = 0; i < ARRAY_SIZE(code_points); i++) {
+    char buffer[Utf8::kMaxEncodedLength];
+    int length = Utf8::Encode(code_points[i], buffer);
+    EXPECT_EQ(lengths[i], length);
+    // Everything but the encoded surrogate is well-formed.
+    EXPECT_EQ(code_points[i] == 0xD800 ? 0 : -1,
+              Utf8::Validate(buffer, length));
+  }
+  char buffer[Utf8::kMaxEncodedLength];
+  EXPECT_EQ(3, Utf8::Encode(0x20AC, buffer));
+  EXPECT_EQ(0, memcmp("\xe2\x82\xac", buffer, 3));
+}
+
+TEST_CASE(Utf8ValidateSpeed) {
+  Zone zone;
+  const int SIZE = 1 << 20;
+  const int REPEAT = 10;
+  char* buffer = static_cast<char*>(zone.Allocate(SIZE));
+  for (int i = 0; i < SIZE; i++) buffer[i] = 'a' + i % 26;
+  // Sprinkle in a few non-ASCII characters, like comments in real code.
+  for (int i = 0; i + 2 < SIZE; i += 4 * KB) {
+    buffer[i] = '\xc3';
+    buffer[i + 1] = '\xa9';
+  }
+
+  i64 start = OS::CurrentTime();
+  for (int i = 0; i < REPEAT; i++) {
+    EXPECT_EQ(-1, Utf8::Validate(buffer, SIZE));
+  }
+  i64 time = OS::CurrentTime() - start;
+  if (time <= 0) time = 1;
+  printf("Utf8ValidateSpeed: %s %.1f MB/s\n",
+         Simd::kIsVectorized ? "sse2" : "fallback",
+         static_cast<double>(SIZE) * REPEAT / time);
+}
+
+}  // namespace rart
@@ -7,13 +7,18 @@
 namespace rart {
 
 u32 Utils::StringHash(const uint16_t* data, int length) {
+  return StringHash(reinterpret_cast<const char*>(data),
+                    length * sizeof(uint16_t));
+}
+
+u32 Utils::StringHash(const char* data, int length) {
   // This implementation is based on the public domain MurmurHash
   // version 2.0. It assumes that we the underlying CPU can read from
   // unaligned addresses. The constants M and R have been determined
   // to work well experimentally.
   const u32 M = 0x5bd1e995;
   const int R = 24;
-  int size = length * sizeof(uint16_t);
+  int size = length;
   u32 hash = size;
 
   // Mix four bytes at a time into the hash.
@@ -48,4 +53,38 @@ u32 Utils::StringHash(const uint16_t* data, int length) {
   return hash;
 }
 
+u64 Utils::ContentHash(const char* data, int length) {
+  // This is the 64-bit version of MurmurHash 2.0, MurmurHash64A, which
+  // mixes eight bytes at a time.
+  const u64 M = 0xc6a4a7935bd1e995ULL;
+  const int R = 47;
+  int size = length;
+  u64 hash = 0x5bd1e995 ^ (size * M);
+
+  const u8* cursor = reinterpret_cast<const u8*>(data);
+  while (size >= 8) {
+    u64 part;
+    memcpy(&part, cursor, sizeof(part));
+    part *= M;
+    part ^= part >> R;
+    part *= M;
+    hash ^= part;
+    hash *= M;
+    cursor += 8;
+    size -= 8;
+  }
+
+  if (size > 0) {
+    u64 part = 0;
+    memcpy(&part, cursor, size);
+    hash ^= part;
+    hash *= M;
+  }
+
+  hash ^= hash >> R;
+  hash *= M;
+  hash ^= hash >> R;
+  return hash;
+}
+
 }  // namespace rart
@@ -59,6 +59,11 @@ class Utils {
 
   // Computes a hash value for the given string.
   static u32 StringHash(const uint16_t* data, int length);
+  static u32 StringHash(const char* data, int length);
+
+  // Computes a 64-bit hash of a block of memory, for identifying
+  // contents across runs, like whole files.
+  static u64 ContentHash(const char* data, int length);
 
   // Bit width testers.
   static bool IsInt8(word value) {
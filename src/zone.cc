@@ -12,7 +12,7 @@
 
 namespace rart {
 
-uword Zone::allocated_ = 0;
+std::atomic<uword> Zone::allocated_(0);
 
 // Zone segments represent chunks of memory: They have starting
 // address encoded in the this pointer and a size in bytes. They are
@@ -20,6 +20,7 @@ uword Zone::allocated_ = 0;
 class Zone::Segment {
  public:
   Segment* next() const { return next_; }
+  void set_next(Segment* value) { next_ = value; }
   int size() const { return size_; }
 
   uword start() { return address(sizeof(Segment)); }
@@ -87,6 +88,32 @@ void Zone::DeleteAll() {
   position_ = limit_ = 0;
 }
 
+void Zone::Adopt(Zone* other) {
+  Segment* adopted = other->head_;
+  if (adopted == NULL) return;
+  if (head_ == NULL) {
+    // Keep allocating in the other zone's head segment.
+    head_ = adopted;
+    position_ = other->position_;
+    limit_ = other->limit_;
+  } else {
+    // Keep allocating in our own head segment, so link the adopted
+    // segments in after it.
+#ifdef DEBUG
+    // The rest of the other head segment will continue to be unused.
+    if (other->position_ < other->limit_) {
+      allocated_ += other->limit_ - other->position_;
+    }
+#endif
+    Segment* last = adopted;
+    while (last->next() != NULL) last = last->next();
+    last->set_next(head_->next());
+    head_->set_next(adopted);
+  }
+  other->head_ = NULL;
+  other->position_ = other->limit_ = 0;
+}
+
 uword Zone::AllocateExpand(int size) {
   // Make sure the requested size is already properly aligned and that
   // there isn't enough room in the Zone to satisfy the request.
@@ -5,6 +5,8 @@
 #ifndef SRC_ZONE_H_
 #define SRC_ZONE_H_
 
+#include <atomic>
+
 #include "src/allocation.h"
 #include "src/utils.h"
 
@@ -31,6 +33,10 @@ class Zone : public StackResource {
   // Delete all objects and free all memory allocated in the zone.
   void DeleteAll();
 
+  // Move all memory allocated in the other zone to this zone, so it lives
+  // as long as this zone. The other zone is left empty.
+  void Adopt(Zone* other);
+
   // Get the number of total zone-allocated bytes.
   // This is always 0 in release mode.
   static uword allocated() { return allocated_; }
@@ -63,7 +69,9 @@ class Zone : public StackResource {
   // Expand the zone to accommodate an allocation of 'size' bytes.
   uword AllocateExpand(int size);
 
-  static uword allocated_;
+  // Zones are used on several threads at once, for instance by the parse
+  // threads, so the count is updated atomically.
+  static std::atomic<uword> allocated_;
 };
 
 inline void* Zone::Allocate(int size) {
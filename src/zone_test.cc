@@ -19,6 +19,30 @@ TEST_CASE(Zone) {
   EXPECT(zone.Allocate(10 * MB) != NULL);
 }
 
+TEST_CASE(ZoneAdopt) {
+  Zone zone;
+  int* first = static_cast<int*>(zone.Allocate(sizeof(int)));
+  *first = 1;
+  int* second;
+  {
+    Zone other;
+    second = static_cast<int*>(other.Allocate(sizeof(int)));
+    *second = 2;
+    EXPECT(other.Allocate(10 * MB) != NULL);
+    zone.Adopt(&other);
+    // The other zone can be used again after giving up its memory.
+    EXPECT(other.Allocate(10) != NULL);
+  }
+  EXPECT_EQ(1, *first);
+  EXPECT_EQ(2, *second);
+
+  // Adopting into an empty zone.
+  Zone empty;
+  empty.Adopt(&zone);
+  EXPECT_EQ(2, *second);
+  EXPECT(empty.Allocate(10) != NULL);
+}
+
 TEST_CASE(ZoneAllocated) {
   static int marker;
   class SimpleZoneObject : public ZoneAllocated {